@@ -0,0 +1,191 @@
+#ifndef LATTICE_BOLTZMANN_AUTO_TUNE_HPP
+#define LATTICE_BOLTZMANN_AUTO_TUNE_HPP
+
+#include "World.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+namespace lbm
+{
+
+struct AutoTuneResult
+{
+    StepConfig config;
+    double     seconds_per_step;
+    bool       cached; // true if it was read from the cache file
+};
+
+// Picks the fastest StepConfig for a World by timing a few steps of each
+// candidate on a copy of it. The result is stored in a cache file keyed by
+// the CPU model, the number of hardware threads and the shape of the world,
+// so that later runs on the same machine skip the search.
+//
+// The search covers what StepConfig can vary: the kernel, the tile shape and
+// the number of threads. World has a single cell layout (one Grid per cell)
+// and leaves vectorization to the compiler, so there is no SIMD width or data
+// layout to choose from; those axes are left out rather than faked.
+struct AutoTuner
+{
+  public:
+
+    explicit AutoTuner(std::string cache_file = "lbm_autotune.cache",
+                       std::size_t steps = 10)
+        : cache_file_(std::move(cache_file)), steps_(std::max<std::size_t>(steps, 1))
+    {}
+
+    // find the best config for `w` and apply it
+    AutoTuneResult tune(World& w) const
+    {
+        const auto key = this->key_of(w);
+        if(const auto cached = this->lookup(key))
+        {
+            w.configure(cached->config);
+            return *cached;
+        }
+
+        World trial(w); // benchmark on a copy, keep the state of `w`
+        trial.step();   // warm up caches and the OpenMP thread pool
+
+        AutoTuneResult best{StepConfig{}, std::numeric_limits<double>::infinity(), false};
+        for(const auto& c : this->candidates(w))
+        {
+            trial.configure(c);
+            trial.step();
+
+            const auto start = std::chrono::steady_clock::now();
+            for(std::size_t i=0; i<steps_; ++i)
+            {
+                trial.step();
+            }
+            const auto stop = std::chrono::steady_clock::now();
+
+            const double t = std::chrono::duration<double>(stop - start).count() / steps_;
+            if(t < best.seconds_per_step)
+            {
+                best.config           = c;
+                best.seconds_per_step = t;
+            }
+        }
+
+        this->store(key, best);
+        w.configure(best.config);
+        return best;
+    }
+
+    // kernel x tile shape x threads
+    std::vector<StepConfig> candidates(const World& w) const
+    {
+        const std::int32_t max_threads = std::max(1, default_threads());
+
+        std::vector<std::int32_t> threads{1};
+        for(std::int32_t t=2; t<max_threads; t*=2) {threads.push_back(t);}
+        if(1 < max_threads) {threads.push_back(max_threads);}
+
+        // {0, 0}: no tiling, {0, n}: bands of n rows, {n, m}: n x m blocks
+        std::vector<std::pair<std::int32_t, std::int32_t>> tiles{
+            {0, 0}, {0, 8}, {0, 32}, {64, 16}, {128, 32}, {32, 32}
+        };
+        tiles.erase(std::remove_if(tiles.begin(), tiles.end(),
+            [&w](const auto& t) {
+                return w.size_x() < t.first || w.size_y() < t.second;
+            }), tiles.end());
+
+        std::vector<StepConfig> cs;
+        for(const auto kernel : {StepKernel::Split, StepKernel::Fused})
+        {
+            for(const auto& [tx, ty] : tiles)
+            {
+                for(const auto t : threads)
+                {
+                    // without tiles, the streaming runs on one thread anyway
+                    if(tx == 0 && ty == 0 && kernel == StepKernel::Fused && t != 1) {continue;}
+                    cs.push_back(StepConfig{kernel, tx, ty, t});
+                }
+            }
+        }
+        return cs;
+    }
+
+  private:
+
+    static std::int32_t default_threads() noexcept
+    {
+#ifdef _OPENMP
+        return omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+
+    static std::string cpu_model()
+    {
+        std::ifstream ifs("/proc/cpuinfo");
+        std::string line;
+        while(std::getline(ifs, line))
+        {
+            if(line.rfind("model name", 0) != 0) {continue;}
+            const auto colon = line.find(':');
+            if(colon == std::string::npos) {break;}
+            const auto first = line.find_first_not_of(' ', colon + 1);
+            return (first == std::string::npos) ? std::string("unknown") : line.substr(first);
+        }
+        return "unknown";
+    }
+
+    std::string key_of(const World& w) const
+    {
+        std::ostringstream oss;
+        oss << cpu_model() << " | " << std::thread::hardware_concurrency() << " threads"
+            << " | " << default_threads() << " omp | " << w.size_x() << "x" << w.size_y();
+        return oss.str();
+    }
+
+    // one line per entry: key <TAB> kernel tile_x tile_y threads seconds_per_step
+    std::optional<AutoTuneResult> lookup(const std::string& key) const
+    {
+        std::ifstream ifs(cache_file_);
+        std::string line;
+        std::optional<AutoTuneResult> found;
+        while(std::getline(ifs, line))
+        {
+            const auto tab = line.find('\t');
+            if(tab == std::string::npos || line.compare(0, tab, key) != 0) {continue;}
+
+            std::istringstream iss(line.substr(tab + 1));
+            int kernel;
+            AutoTuneResult r{StepConfig{}, 0.0, true};
+            if(iss >> kernel >> r.config.tile_x >> r.config.tile_y >> r.config.threads >> r.seconds_per_step)
+            {
+                r.config.kernel = static_cast<StepKernel>(kernel);
+                found = r; // the last entry wins
+            }
+        }
+        return found;
+    }
+
+    void store(const std::string& key, const AutoTuneResult& r) const
+    {
+        std::ofstream ofs(cache_file_, std::ios::app);
+        ofs << key << '\t' << static_cast<int>(r.config.kernel) << ' '
+            << r.config.tile_x << ' ' << r.config.tile_y << ' ' << r.config.threads << ' '
+            << r.seconds_per_step << '\n';
+        return;
+    }
+
+  private:
+
+    std::string cache_file_;
+    std::size_t steps_;
+};
+
+} // lbm
+#endif // LATTICE_BOLTZMANN_AUTO_TUNE_HPP
@@ -51,6 +51,9 @@ struct BGK
         return 0;
     }
 
+    double viscosity() const noexcept {return viscosity_;}
+    double omega()     const noexcept {return omega_;}
+
   private:
 
     double viscosity_;
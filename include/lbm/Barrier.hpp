@@ -32,6 +32,9 @@ struct Barrier final : public GridBase
         distribution_[static_cast<std::size_t>(dir)] = d;
     }
 
+    std::array<double, 9>&       populations()       noexcept {return distribution_;}
+    std::array<double, 9> const& populations() const noexcept {return distribution_;}
+
     bool bounces() const noexcept override {return true;}
     std::pair<Direction, double> bounce_back(const Direction dir) noexcept override
     {
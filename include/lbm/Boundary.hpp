@@ -5,27 +5,193 @@
 #include "Vector.hpp"
 
 #include <array>
+#include <utility>
+#include <cassert>
+#include <cstdint>
 
 namespace lbm
 {
 
+enum class BoundaryKind : std::uint8_t
+{
+    Equilibrium,     // rho and u are fixed (non-equilibrium bounce-back)
+    ZouHeVelocity,   // u is fixed, rho follows from the known populations
+    ZouHePressure,   // rho and the tangential u are fixed, the normal u follows
+    Outflow,         // zero gradient: the missing populations are copied from inside
+    PressureOutflow, // rho is fixed, u is copied from inside
+};
+
+// the kinds that take the state of the inner neighbor of the cell
+inline bool is_outflow(const BoundaryKind k) noexcept
+{
+    return k == BoundaryKind::Outflow || k == BoundaryKind::PressureOutflow;
+}
+
+// Parameters of a boundary condition, shared by all the ConstantFlow cells
+// that refer to it. World keeps them in a table and applies them to the
+// boundary cells after streaming.
+struct BoundaryCondition
+{
+    BoundaryKind kind;
+    double rho;
+    Vector u;
+
+    static BoundaryCondition equilibrium(double rho, Vector u)
+    {
+        return BoundaryCondition{BoundaryKind::Equilibrium, rho, u};
+    }
+    // `rho` is only used at corners, where Zou-He is not defined
+    static BoundaryCondition velocity(Vector u, double rho = 1.0)
+    {
+        return BoundaryCondition{BoundaryKind::ZouHeVelocity, rho, u};
+    }
+    // the normal component of `u` is only used at corners
+    static BoundaryCondition pressure(double rho, Vector u = Vector{0, 0})
+    {
+        return BoundaryCondition{BoundaryKind::ZouHePressure, rho, u};
+    }
+    // the populations that would come from outside are those of the inner
+    // neighbor. this fixes neither rho nor u, so the mass in the lattice is
+    // not conserved: with velocity inlets and no pressure boundary, rho
+    // drifts. use pressure_outflow() there
+    static BoundaryCondition outflow()
+    {
+        return BoundaryCondition{BoundaryKind::Outflow, 1.0, Vector{0, 0}};
+    }
+    // a pressure outlet: rho is held at `rho` and u is taken from the inner
+    // neighbor, so the outflow follows the flow and the mean rho stays put
+    static BoundaryCondition pressure_outflow(double rho = 1.0)
+    {
+        return BoundaryCondition{BoundaryKind::PressureOutflow, rho, Vector{0, 0}};
+    }
+};
+
+// Rebuilds the populations of a boundary cell after streaming and returns its
+// rho and u. (nx, ny) is the inward normal of the edge of the lattice the cell
+// is on (each component is -1, 0 or 1) and bit q of `unknown` is set if the
+// population q would have come from outside of the lattice.
+//
+// Zou-He needs a straight edge; at corners (and on cells that are not on an
+// edge) both Zou-He kinds fall back to the equilibrium rule with the rho and
+// u of the condition. The outflow kinds need the inner neighbor and are
+// applied with apply_outflow().
+inline std::pair<double, Vector> apply_boundary(const BoundaryCondition& bc,
+        std::array<double, 9>& f, const std::int32_t nx, const std::int32_t ny,
+        const std::uint16_t unknown)
+{
+    assert( ! is_outflow(bc.kind));
+
+    const bool straight = (nx == 0) != (ny == 0);
+    if(bc.kind == BoundaryKind::Equilibrium || ! straight)
+    {
+        for(std::size_t q=1; q<9; ++q)
+        {
+            if((unknown >> q & 1u) == 0) {continue;}
+            const auto b = d2q9::opposite[q];
+            f[q] = d2q9::equilibrium(q, bc.rho, bc.u.x, bc.u.y) +
+                   f[b] - d2q9::equilibrium(b, bc.rho, bc.u.x, bc.u.y);
+        }
+        return {bc.rho, bc.u};
+    }
+
+    // Zou & He (1997), written for any axis-aligned edge with the tangent t
+    const std::int32_t tx = -ny;
+    const std::int32_t ty =  nx;
+
+    double f_along = 0; // populations moving along the edge
+    double f_out   = 0; // populations that leave the lattice through the edge
+    std::size_t q_t = 0, q_mt = 0;
+    for(std::size_t q=0; q<9; ++q)
+    {
+        const auto cn = d2q9::cx[q] * nx + d2q9::cy[q] * ny;
+        if(cn == 0) {f_along += f[q];}
+        if(cn <  0) {f_out   += f[q];}
+        if(d2q9::cx[q] ==  tx && d2q9::cy[q] ==  ty) {q_t  = q;}
+        if(d2q9::cx[q] == -tx && d2q9::cy[q] == -ty) {q_mt = q;}
+    }
+
+    double rho = bc.rho;
+    double un  = bc.u.x * nx + bc.u.y * ny;
+    const double ut = bc.u.x * tx + bc.u.y * ty;
+    if(bc.kind == BoundaryKind::ZouHeVelocity)
+    {
+        rho = (f_along + 2 * f_out) / (1 - un);
+    }
+    else
+    {
+        un = 1 - (f_along + 2 * f_out) / rho;
+    }
+
+    const double df_t = f[q_t] - f[q_mt];
+    for(std::size_t q=1; q<9; ++q)
+    {
+        const auto cn = d2q9::cx[q] * nx + d2q9::cy[q] * ny;
+        if(cn <= 0) {continue;}
+        const auto b  = d2q9::opposite[q];
+        const auto ct = d2q9::cx[q] * tx + d2q9::cy[q] * ty;
+        if(ct == 0)
+        {
+            f[q] = f[b] + (2 / 3.0) * rho * un;
+        }
+        else
+        {
+            f[q] = f[b] + (1 / 6.0) * rho * un + 0.5 * ct * (rho * ut - df_t);
+        }
+    }
+    return {rho, Vector{un * nx + ut * tx, un * ny + ut * ty}};
+}
+
+// The same for the outflow kinds. `inner` are the populations of the fluid
+// neighbor along the inward normal, after streaming.
+inline std::pair<double, Vector> apply_outflow(const BoundaryCondition& bc,
+        std::array<double, 9>& f, const std::array<double, 9>& inner,
+        const std::uint16_t unknown)
+{
+    assert(is_outflow(bc.kind));
+
+    if(bc.kind == BoundaryKind::PressureOutflow)
+    {
+        double rho = 0, jx = 0, jy = 0;
+        for(std::size_t q=0; q<9; ++q)
+        {
+            rho += inner[q];
+            jx  += d2q9::cx[q] * inner[q];
+            jy  += d2q9::cy[q] * inner[q];
+        }
+        // the equilibrium rule does not look at the normal
+        return apply_boundary(BoundaryCondition::equilibrium(bc.rho, Vector{jx / rho, jy / rho}),
+                              f, 0, 0, unknown);
+    }
+
+    double rho = 0, jx = 0, jy = 0;
+    for(std::size_t q=0; q<9; ++q)
+    {
+        if(unknown >> q & 1u) {f[q] = inner[q];}
+        rho += f[q];
+        jx  += d2q9::cx[q] * f[q];
+        jy  += d2q9::cy[q] * f[q];
+    }
+    return {rho, Vector{jx / rho, jy / rho}};
+}
+
+// A cell whose populations are rebuilt by a BoundaryCondition after streaming.
+// It only stores its populations and the index of the condition in the table
+// of the World; rho and u are kept by the World. There is no default
+// constructor: the condition must come from World::add_boundary().
 struct ConstantFlow final : public GridBase
 {
+    explicit ConstantFlow(std::uint32_t condition) noexcept
+        : distribution_{}, condition_(condition)
+    {}
     ~ConstantFlow() override = default;
 
     void initialize(const BGK& bgk, const double rho, const Vector u) override
     {
-        this->density_  = rho;
-        this->velocity_ = u;
-
-        // equilibrium distribution
-
         for(const auto& dir : all_dirs)
         {
             this->distribution_.at(static_cast<std::size_t>(dir)) =
                 bgk.equilibrium(dir, rho, u);
         }
-        this->eq_distribution_ = this->distribution_; // keep it
     }
 
     double  distribution(const Direction dir) const noexcept override
@@ -35,21 +201,13 @@ struct ConstantFlow final : public GridBase
     }
     void set_distribution(const Direction dir, double d) noexcept override
     {
-        const auto back = ::lbm::bounce_back(dir);
-        const auto dir_idx  = static_cast<std::size_t>(dir);
-        const auto back_idx = static_cast<std::size_t>(back);
-
-        assert(dir_idx  < distribution_.size());
-        assert(back_idx < distribution_.size());
-
-        // bounce non-equilibrium part of the distribution
-
-        distribution_[dir_idx ] = d;
-        distribution_[back_idx] = eq_distribution_[back_idx] + (d - eq_distribution_[dir_idx]);
-
-        return ;
+        assert(static_cast<std::size_t>(dir) < distribution_.size());
+        distribution_[static_cast<std::size_t>(dir)] = d;
     }
 
+    std::array<double, 9>&       populations()       noexcept {return distribution_;}
+    std::array<double, 9> const& populations() const noexcept {return distribution_;}
+
     bool bounces() const noexcept override {return false;}
 
     std::pair<Direction, double> bounce_back(const Direction dir) noexcept override
@@ -57,27 +215,37 @@ struct ConstantFlow final : public GridBase
         return {Direction::None, 0};
     }
 
-    // no fluid inside the barrier
+    // moments of the populations. the imposed ones are in World
     double density() const override
     {
-        return density_;
+        double d = 0;
+        for(const auto& distr : distribution_)
+        {
+            d += distr;
+        }
+        return d;
     }
     Vector velocity() const override
     {
         return velocity(density());
     }
-    Vector velocity(const double) const override
+    Vector velocity(const double rho) const override
     {
-        return velocity_;
+        double jx = 0, jy = 0;
+        for(std::size_t q=0; q<9; ++q)
+        {
+            jx += d2q9::cx[q] * distribution_[q];
+            jy += d2q9::cy[q] * distribution_[q];
+        }
+        return Vector{jx / rho, jy / rho};
     }
 
-  private:
+    std::uint32_t condition() const noexcept {return condition_;}
 
-    double density_;
-    Vector velocity_;
+  private:
 
-    std::array<double, 9> eq_distribution_;
     std::array<double, 9> distribution_;
+    std::uint32_t condition_; // index of the BoundaryCondition in World
 };
 
 } // lbm
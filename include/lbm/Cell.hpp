@@ -34,6 +34,10 @@ struct Cell final : public GridBase
         return ;
     }
 
+    // all the populations at once, for the loops of World over the lattice
+    std::array<double, 9>&       populations()       noexcept {return distribution_;}
+    std::array<double, 9> const& populations() const noexcept {return distribution_;}
+
     bool bounces() const noexcept override {return false;}
     std::pair<Direction, double> bounce_back(const Direction d) noexcept override
     {
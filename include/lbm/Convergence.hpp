@@ -0,0 +1,95 @@
+#ifndef LATTICE_BOLTZMANN_CONVERGENCE_HPP
+#define LATTICE_BOLTZMANN_CONVERGENCE_HPP
+
+#include <algorithm>
+#include <optional>
+#include <cmath>
+#include <cstddef>
+
+namespace lbm
+{
+
+// thresholds for the steady-state detection.
+// L2 norms are relative to the current field, Linf norms are absolute.
+struct ConvergenceCriteria
+{
+    std::size_t interval      = 100;  // check the change once per `interval` steps
+    double      velocity_l2   = 1e-7;
+    double      velocity_linf = 1e-6;
+    double      density_l2    = 1e-7;
+    double      density_linf  = 1e-6;
+};
+
+// change of the macroscopic fields during a single step
+struct Residual
+{
+    std::size_t step;
+    double velocity_l2;
+    double velocity_linf;
+    double density_l2;
+    double density_linf;
+};
+
+// Raw sums collected while the moments are updated. World reduces them over
+// all cells in the same loop that recomputes rho and u, so checking the
+// residual does not cost an additional sweep.
+struct ResidualSums
+{
+    double du2      = 0; // sum |u_new - u_old|^2
+    double u2       = 0; // sum |u_new|^2
+    double du_max   = 0; // max |u_new - u_old|^2
+    double drho2    = 0; // sum (rho_new - rho_old)^2
+    double rho2     = 0; // sum rho_new^2
+    double drho_max = 0; // max |rho_new - rho_old|
+};
+
+struct ConvergenceMonitor
+{
+  public:
+
+    explicit ConvergenceMonitor(ConvergenceCriteria c)
+        : criteria_(c), converged_(false)
+    {
+        criteria_.interval = std::max<std::size_t>(criteria_.interval, 1);
+    }
+
+    bool should_check(const std::size_t step) const noexcept
+    {
+        return step % criteria_.interval == 0;
+    }
+
+    void record(const std::size_t step, const ResidualSums& s)
+    {
+        const auto relative = [](const double diff2, const double norm2) {
+            return (0 < norm2) ? std::sqrt(diff2 / norm2) : std::sqrt(diff2);
+        };
+
+        Residual r;
+        r.step          = step;
+        r.velocity_l2   = relative(s.du2,   s.u2);
+        r.velocity_linf = std::sqrt(s.du_max);
+        r.density_l2    = relative(s.drho2, s.rho2);
+        r.density_linf  = s.drho_max;
+        this->last_ = r;
+
+        this->converged_ = r.velocity_l2   <= criteria_.velocity_l2   &&
+                           r.velocity_linf <= criteria_.velocity_linf &&
+                           r.density_l2    <= criteria_.density_l2    &&
+                           r.density_linf  <= criteria_.density_linf;
+        return;
+    }
+
+    bool converged() const noexcept {return converged_;}
+
+    std::optional<Residual> const& last()     const noexcept {return last_;}
+    ConvergenceCriteria     const& criteria() const noexcept {return criteria_;}
+
+  private:
+
+    ConvergenceCriteria     criteria_;
+    bool                    converged_;
+    std::optional<Residual> last_;
+};
+
+} // lbm
+#endif // LATTICE_BOLTZMANN_CONVERGENCE_HPP
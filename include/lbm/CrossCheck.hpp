@@ -0,0 +1,261 @@
+#ifndef LATTICE_BOLTZMANN_CROSS_CHECK_HPP
+#define LATTICE_BOLTZMANN_CROSS_CHECK_HPP
+
+// Differential testing of step implementations.
+//
+// World with the default StepConfig is the reference engine. A candidate is
+// any Engine that can be built from a set-up World; both are run for the
+// same number of steps on randomized geometries (Barrier blocks and
+// ConstantFlow cells inside a ConstantFlow frame) and the largest deviation
+// of each field is reported together with the speed of both engines.
+
+#include "BGK.hpp"
+#include "Ensemble.hpp"
+#include "Geometry.hpp"
+#include "World.hpp"
+#include "Vector.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+
+namespace lbm
+{
+
+// a step implementation under test
+struct Engine
+{
+    virtual ~Engine() = default;
+
+    virtual void step() = 0;
+    // rho and u of all cells, row-major (y * size_x + x)
+    virtual void fields(std::vector<double>& rho, std::vector<Vector>& u) const = 0;
+};
+
+// World with a given StepConfig. With the default config this is the reference
+struct WorldEngine final : public Engine
+{
+    WorldEngine(const World& w, StepConfig c): world_(w) {world_.configure(c);}
+    ~WorldEngine() override = default;
+
+    void step() override {world_.step();}
+    void fields(std::vector<double>& rho, std::vector<Vector>& u) const override
+    {
+        rho = world_.densities();
+        u   = world_.velocities();
+    }
+
+  private:
+    World world_;
+};
+
+// a one-member Ensemble. ConstantFlow cells keep (rho, u) of the member
+struct EnsembleEngine final : public Engine
+{
+    EnsembleEngine(const World& w, double rho, Vector u)
+        : ensemble_(w, {EnsembleMember{w.model(), rho, u}})
+    {}
+    ~EnsembleEngine() override = default;
+
+    void step() override {ensemble_.step();}
+    void fields(std::vector<double>& rho, std::vector<Vector>& u) const override
+    {
+        ensemble_.densities (0, rho);
+        ensemble_.velocities(0, u);
+    }
+
+  private:
+    Ensemble ensemble_;
+};
+
+struct CrossCheckConfig
+{
+    std::int32_t  size_x    = 96;
+    std::int32_t  size_y    = 64;
+    std::size_t   steps     = 500;
+    std::size_t   cases     = 4;    // number of random geometries
+    std::uint64_t seed      = 1;
+    double        viscosity = 0.02;
+    double        rho       = 1.0;  // initial state and the state at ConstantFlow
+    Vector        u         = Vector{0.08, 0.0};
+    std::size_t   barriers  = 6;    // random Barrier blocks per geometry
+    std::size_t   boundaries = 4;   // random ConstantFlow cells inside the lattice
+    double        tolerance = 1e-10;
+};
+
+// builds a candidate from the initial World of a case
+using EngineFactory = std::function<std::unique_ptr<Engine>(const World&, const CrossCheckConfig&)>;
+
+struct CrossCheckResult
+{
+    std::string   candidate;
+    std::uint64_t seed;              // of the geometry
+    double        density_error;     // max |rho_c - rho_r| over non-barrier cells
+    double        velocity_x_error;
+    double        velocity_y_error;
+    double        reference_mlups;
+    double        candidate_mlups;
+
+    bool passed(const double tolerance) const noexcept
+    {
+        // NaN fails as well
+        return density_error    <= tolerance &&
+               velocity_x_error <= tolerance &&
+               velocity_y_error <= tolerance;
+    }
+};
+
+struct CrossCheck
+{
+  public:
+
+    explicit CrossCheck(CrossCheckConfig cfg = CrossCheckConfig{}): config_(cfg) {}
+
+    void add(std::string name, EngineFactory f)
+    {
+        this->candidates_.push_back(Candidate{std::move(name), std::move(f)});
+    }
+
+    // run the reference and all the candidates on every geometry
+    std::vector<CrossCheckResult> run() const
+    {
+        const std::size_t ncells = static_cast<std::size_t>(config_.size_x) * config_.size_y;
+
+        std::vector<CrossCheckResult> results;
+        for(std::size_t c=0; c<config_.cases; ++c)
+        {
+            const std::uint64_t seed = config_.seed + c;
+            const Geometry geometry  = this->random_geometry(seed);
+
+            World initial(config_.size_x, config_.size_y, BGK(config_.viscosity));
+            initial.load(geometry, config_.rho, config_.u);
+
+            std::vector<double> ref_rho, rho;
+            std::vector<Vector> ref_u, u;
+            WorldEngine reference(initial, StepConfig{});
+            const double ref_mlups = this->advance(reference, ncells);
+            reference.fields(ref_rho, ref_u);
+
+            for(const auto& cand : candidates_)
+            {
+                const auto engine = cand.factory(initial, config_);
+                const double mlups = this->advance(*engine, ncells);
+                engine->fields(rho, u);
+
+                CrossCheckResult r{cand.name, seed, 0.0, 0.0, 0.0, ref_mlups, mlups};
+                for(std::size_t i=0; i<ncells; ++i)
+                {
+                    if(geometry.cells()[i] == CellKind::Barrier) {continue;}
+                    r.density_error    = max_error(r.density_error,    rho[i], ref_rho[i]);
+                    r.velocity_x_error = max_error(r.velocity_x_error, u[i].x, ref_u[i].x);
+                    r.velocity_y_error = max_error(r.velocity_y_error, u[i].y, ref_u[i].y);
+                }
+                results.push_back(r);
+            }
+        }
+        return results;
+    }
+
+    // one line per candidate and geometry
+    void write(std::ostream& os, const std::vector<CrossCheckResult>& results) const
+    {
+        os << std::left << std::setw(24) << "candidate" << std::right
+           << std::setw(6)  << "seed"
+           << std::setw(12) << "rho" << std::setw(12) << "u.x" << std::setw(12) << "u.y"
+           << std::setw(12) << "ref MLUPS" << std::setw(12) << "MLUPS" << "  result\n";
+        for(const auto& r : results)
+        {
+            os << std::left << std::setw(24) << r.candidate << std::right
+               << std::setw(6) << r.seed << std::scientific << std::setprecision(2)
+               << std::setw(12) << r.density_error
+               << std::setw(12) << r.velocity_x_error
+               << std::setw(12) << r.velocity_y_error
+               << std::fixed << std::setprecision(1)
+               << std::setw(12) << r.reference_mlups
+               << std::setw(12) << r.candidate_mlups
+               << (r.passed(config_.tolerance) ? "  ok\n" : "  FAILED\n");
+        }
+        os << std::defaultfloat;
+        return;
+    }
+
+    // a ConstantFlow frame with random Barrier blocks and ConstantFlow cells
+    Geometry random_geometry(const std::uint64_t seed) const
+    {
+        const auto nx = config_.size_x;
+        const auto ny = config_.size_y;
+
+        std::mt19937_64 rng(seed);
+        std::uniform_int_distribution<std::int32_t> px(2, std::max(2, nx - 3));
+        std::uniform_int_distribution<std::int32_t> py(2, std::max(2, ny - 3));
+        std::uniform_int_distribution<std::int32_t> extent(1, std::max(1, std::min(nx, ny) / 8));
+
+        Geometry g(nx, ny);
+        g.set_edges(CellKind::Boundary);
+        for(std::size_t b=0; b<config_.barriers; ++b)
+        {
+            const auto x0 = px(rng);
+            const auto y0 = py(rng);
+            const auto w  = extent(rng);
+            const auto h  = extent(rng);
+            for(std::int32_t y=y0; y<std::min(y0 + h, ny - 2); ++y)
+            {
+                for(std::int32_t x=x0; x<std::min(x0 + w, nx - 2); ++x)
+                {
+                    g.set(x, y, CellKind::Barrier);
+                }
+            }
+        }
+        for(std::size_t b=0; b<config_.boundaries; ++b)
+        {
+            g.set(px(rng), py(rng), CellKind::Boundary);
+        }
+        return g;
+    }
+
+    CrossCheckConfig const& config() const noexcept {return config_;}
+
+  private:
+
+    // advances `e` by the configured number of steps and returns its MLUPS
+    double advance(Engine& e, const std::size_t ncells) const
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for(std::size_t s=0; s<config_.steps; ++s)
+        {
+            e.step();
+        }
+        const auto stop = std::chrono::steady_clock::now();
+        const double t = std::chrono::duration<double>(stop - start).count();
+        return (0 < t) ? (static_cast<double>(ncells) * config_.steps / t * 1e-6) : 0.0;
+    }
+
+    static double max_error(const double current, const double a, const double b) noexcept
+    {
+        const double d = std::abs(a - b);
+        return std::isnan(d) ? std::numeric_limits<double>::infinity() : std::max(current, d);
+    }
+
+  private:
+
+    struct Candidate
+    {
+        std::string   name;
+        EngineFactory factory;
+    };
+
+    CrossCheckConfig       config_;
+    std::vector<Candidate> candidates_;
+};
+
+} // lbm
+#endif // LATTICE_BOLTZMANN_CROSS_CHECK_HPP
@@ -34,6 +34,26 @@ inline constexpr std::array<Direction, 9> all_dirs{{
     Direction::RightDown
 }};
 
+// D2Q9 lattice constants indexed by static_cast<std::size_t>(Direction), for
+// kernels that work on raw population arrays instead of Grid.
+namespace d2q9
+{
+inline constexpr std::array<std::int32_t, 9> cx{{0, 1, 1, 0, -1, -1, -1,  0,  1}};
+inline constexpr std::array<std::int32_t, 9> cy{{0, 0, 1, 1,  1,  0, -1, -1, -1}};
+inline constexpr std::array<std::size_t,  9> opposite{{0, 5, 6, 7, 8, 1, 2, 3, 4}};
+inline constexpr std::array<double, 9> weight{{
+    4/9.0, 1/9.0, 1/36.0, 1/9.0, 1/36.0, 1/9.0, 1/36.0, 1/9.0, 1/36.0
+}};
+
+// the same expression as BGK::equilibrium, written without branches
+inline double equilibrium(const std::size_t q, const double rho, const double ux, const double uy)
+{
+    const double cu = cx[q] * ux + cy[q] * uy;
+    const double u2 = ux * ux + uy * uy;
+    return weight[q] * rho * (1 + 3 * cu + 4.5 * cu * cu - 1.5 * u2);
+}
+} // d2q9
+
 Vector velocity_of(Direction d)
 {
     using enum Direction;
@@ -0,0 +1,267 @@
+#ifndef LATTICE_BOLTZMANN_ENSEMBLE_HPP
+#define LATTICE_BOLTZMANN_ENSEMBLE_HPP
+
+#include "BGK.hpp"
+#include "Direction.hpp"
+#include "World.hpp"
+#include "Vector.hpp"
+
+#include <stdexcept>
+#include <vector>
+#include <cstdint>
+
+namespace lbm
+{
+
+// parameters of one member of an Ensemble. `rho` and `u` are used as the
+// initial state and as the state imposed at ConstantFlow cells.
+struct EnsembleMember
+{
+    BGK    bgk;
+    double rho;
+    Vector u;
+};
+
+// Many same-shaped worlds advanced together.
+//
+// The populations are interleaved lane-wise: the value of member m in
+// direction q at cell i is stored at f[(i * 9 + q) * N + m]. The innermost
+// loops of the kernel run over the members, so a single pass over the
+// lattice advances all of them with contiguous, vectorizable accesses, and
+// the cells are split across threads.
+//
+// The geometry (Barrier / ConstantFlow / fluid) is taken from a World and is
+// shared by all members. Each step streams (pull), applies the boundary
+// conditions, updates the moments and collides, in one sweep:
+//  - a population coming from a Barrier or from outside of the lattice is
+//    bounced back,
+//  - at ConstantFlow cells, a population coming from outside of the lattice
+//    is replaced by the equilibrium of the member plus the non-equilibrium
+//    part of the opposite population, and rho, u are fixed to those of the
+//    member. This is BoundaryKind::Equilibrium with the state of the member;
+//    the boundary conditions registered in the World are not used.
+struct Ensemble
+{
+  public:
+
+    enum class Kind : std::uint8_t {Fluid, Barrier, Boundary};
+
+    Ensemble(const World& shape, std::vector<EnsembleMember> members)
+        : nx_(shape.size_x()), ny_(shape.size_y()), nm_(members.size()),
+          members_(std::move(members)), step_(0)
+    {
+        if(nm_ == 0)
+        {
+            throw std::invalid_argument("lbm::Ensemble: no members");
+        }
+
+        const std::size_t ncells = static_cast<std::size_t>(nx_) * ny_;
+        kind_    .resize(ncells);
+        omega_   .resize(nm_);
+        eq_      .resize(9 * nm_);
+        f_       .resize(ncells * 9 * nm_, 0.0);
+        buffer_  .resize(ncells * 9 * nm_, 0.0);
+        density_ .resize(ncells * nm_, 0.0);
+        velocity_.resize(ncells * nm_, Vector{0, 0});
+
+        for(std::size_t m=0; m<nm_; ++m)
+        {
+            const auto& mem = members_[m];
+            omega_[m] = mem.bgk.omega();
+            for(std::size_t q=0; q<9; ++q)
+            {
+                eq_[q * nm_ + m] = d2q9::equilibrium(q, mem.rho, mem.u.x, mem.u.y);
+            }
+        }
+
+        for(std::int32_t y=0; y<ny_; ++y)
+        {
+            for(std::int32_t x=0; x<nx_; ++x)
+            {
+                const auto& g = shape.at(x, y);
+                const auto  i = idx_of(x, y);
+                kind_[i] = g.is_barrier()  ? Kind::Barrier  :
+                           g.is_boundary() ? Kind::Boundary : Kind::Fluid;
+                if(kind_[i] == Kind::Barrier) {continue;}
+
+                // start from the equilibrium (that is invariant under collision)
+                for(std::size_t q=0; q<9; ++q)
+                {
+                    for(std::size_t m=0; m<nm_; ++m)
+                    {
+                        f_[(i * 9 + q) * nm_ + m] = eq_[q * nm_ + m];
+                    }
+                }
+                for(std::size_t m=0; m<nm_; ++m)
+                {
+                    density_ [i * nm_ + m] = members_[m].rho;
+                    velocity_[i * nm_ + m] = members_[m].u;
+                }
+            }
+        }
+    }
+
+    void step()
+    {
+        const std::size_t nm = nm_;
+        const double* src   = f_.data();
+        double*       dst   = buffer_.data();
+        const double* eq    = eq_.data();
+        const double* omega = omega_.data();
+
+        #pragma omp parallel for schedule(static)
+        for(std::int32_t y=0; y<ny_; ++y)
+        {
+            for(std::int32_t x=0; x<nx_; ++x)
+            {
+                const std::size_t i = idx_of(x, y);
+                double* fi = dst + i * 9 * nm;
+
+                if(kind_[i] == Kind::Barrier)
+                {
+                    for(std::size_t k=0; k<9*nm; ++k) {fi[k] = 0;}
+                    continue;
+                }
+
+                // stream (pull) and bounce back
+                std::array<bool, 9> outside{};
+                for(std::size_t q=0; q<9; ++q)
+                {
+                    const std::int32_t sx = x - d2q9::cx[q];
+                    const std::int32_t sy = y - d2q9::cy[q];
+                    outside[q] = (sx < 0 || nx_ <= sx || sy < 0 || ny_ <= sy);
+
+                    const double* from;
+                    if(outside[q] || kind_[idx_of(sx, sy)] == Kind::Barrier)
+                    {
+                        from = src + (i * 9 + d2q9::opposite[q]) * nm;
+                    }
+                    else
+                    {
+                        from = src + (idx_of(sx, sy) * 9 + q) * nm;
+                    }
+                    double* to = fi + q * nm;
+
+                    #pragma omp simd
+                    for(std::size_t m=0; m<nm; ++m) {to[m] = from[m];}
+                }
+
+                double* rho = density_ .data() + i * nm;
+                Vector* vel = velocity_.data() + i * nm;
+
+                if(kind_[i] == Kind::Boundary)
+                {
+                    for(std::size_t q=1; q<9; ++q)
+                    {
+                        if( ! outside[q]) {continue;}
+                        const auto b = d2q9::opposite[q];
+                        double*       fq = fi + q * nm;
+                        const double* fb = fi + b * nm;
+                        const double* eq_q = eq + q * nm;
+                        const double* eq_b = eq + b * nm;
+
+                        #pragma omp simd
+                        for(std::size_t m=0; m<nm; ++m)
+                        {
+                            fq[m] = eq_q[m] + (fb[m] - eq_b[m]);
+                        }
+                    }
+                    for(std::size_t m=0; m<nm; ++m)
+                    {
+                        rho[m] = members_[m].rho;
+                        vel[m] = members_[m].u;
+                    }
+                }
+                else
+                {
+                    #pragma omp simd
+                    for(std::size_t m=0; m<nm; ++m)
+                    {
+                        double r = 0, jx = 0, jy = 0;
+                        for(std::size_t q=0; q<9; ++q)
+                        {
+                            const double fq = fi[q * nm + m];
+                            r  += fq;
+                            jx += d2q9::cx[q] * fq;
+                            jy += d2q9::cy[q] * fq;
+                        }
+                        rho[m] = r;
+                        vel[m] = Vector{jx / r, jy / r};
+                    }
+                }
+
+                // collide
+                #pragma omp simd
+                for(std::size_t m=0; m<nm; ++m)
+                {
+                    const double r  = rho[m];
+                    const double ux = vel[m].x;
+                    const double uy = vel[m].y;
+                    const double w  = omega[m];
+                    for(std::size_t q=0; q<9; ++q)
+                    {
+                        double& fq = fi[q * nm + m];
+                        fq += w * (d2q9::equilibrium(q, r, ux, uy) - fq);
+                    }
+                }
+            }
+        }
+        std::swap(f_, buffer_);
+        ++step_;
+        return;
+    }
+
+    std::size_t  size()   const noexcept {return nm_;}
+    std::int32_t size_x() const noexcept {return nx_;}
+    std::int32_t size_y() const noexcept {return ny_;}
+    std::size_t  steps()  const noexcept {return step_;}
+
+    EnsembleMember const& member(std::size_t m) const {return members_.at(m);}
+    Kind kind_at(std::int32_t x, std::int32_t y) const {return kind_.at(idx_of(x, y));}
+
+    double density_at(std::size_t m, std::int32_t x, std::int32_t y) const
+    {
+        return density_.at(idx_of(x, y) * nm_ + m);
+    }
+    Vector velocity_at(std::size_t m, std::int32_t x, std::int32_t y) const
+    {
+        return velocity_.at(idx_of(x, y) * nm_ + m);
+    }
+
+    // de-interleave the fields of one member (row-major, y * size_x() + x)
+    void densities(std::size_t m, std::vector<double>& out) const
+    {
+        out.resize(kind_.size());
+        for(std::size_t i=0; i<kind_.size(); ++i) {out[i] = density_[i * nm_ + m];}
+    }
+    void velocities(std::size_t m, std::vector<Vector>& out) const
+    {
+        out.resize(kind_.size());
+        for(std::size_t i=0; i<kind_.size(); ++i) {out[i] = velocity_[i * nm_ + m];}
+    }
+
+  private:
+
+    std::size_t idx_of(std::int32_t x, std::int32_t y) const noexcept
+    {
+        return static_cast<std::size_t>(y) * nx_ + x;
+    }
+
+  private:
+
+    std::int32_t nx_;
+    std::int32_t ny_;
+    std::size_t  nm_;
+    std::vector<EnsembleMember> members_;
+    std::vector<Kind>   kind_;
+    std::vector<double> omega_;    // [member]
+    std::vector<double> eq_;       // [q][member], equilibrium at ConstantFlow
+    std::vector<double> f_;        // [cell][q][member], post-collision
+    std::vector<double> buffer_;
+    std::vector<double> density_;  // [cell][member]
+    std::vector<Vector> velocity_; // [cell][member]
+    std::size_t step_;
+};
+
+} // lbm
+#endif // LATTICE_BOLTZMANN_ENSEMBLE_HPP
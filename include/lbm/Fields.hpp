@@ -0,0 +1,138 @@
+#ifndef LATTICE_BOLTZMANN_FIELDS_HPP
+#define LATTICE_BOLTZMANN_FIELDS_HPP
+
+#include "Profiler.hpp"
+#include "World.hpp"
+#include "Vector.hpp"
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+
+namespace lbm
+{
+
+// Quantities derived from the velocity field, computed for the whole world in
+// a single stencil pass. The buffers are kept between calls and only resized
+// when the shape of the world changes, so one instance can be reused every
+// frame by the renderer, the output and the diagnostics.
+//
+// Gradients are central differences. Like World::rot_z, the values on the
+// outermost layer (where a neighbor is missing) are zero.
+struct DerivedFields
+{
+  public:
+
+    DerivedFields(): nx_(0), ny_(0) {}
+
+    void compute(const World& w)
+    {
+        LBM_PROFILE_SCOPE("derived fields");
+
+        this->resize(w.size_x(), w.size_y());
+
+        const std::int32_t nx = nx_;
+        const std::int32_t ny = ny_;
+
+        const Vector* vel    = w.velocities().data();
+        double*       vort   = vorticity_  .data();
+        double*       speed  = speed_      .data();
+        double*       q      = q_criterion_.data();
+        double*       strain = strain_rate_.data();
+
+        #pragma omp parallel for schedule(static)
+        for(std::int32_t y=0; y<ny; ++y)
+        {
+            const std::size_t row = static_cast<std::size_t>(y) * nx;
+
+            #pragma omp simd
+            for(std::int32_t x=0; x<nx; ++x)
+            {
+                const Vector u = vel[row + x];
+                speed[row + x] = std::sqrt(u.x * u.x + u.y * u.y);
+            }
+
+            if(y == 0 || y == ny-1)
+            {
+                for(std::int32_t x=0; x<nx; ++x)
+                {
+                    vort  [row + x] = 0;
+                    q     [row + x] = 0;
+                    strain[row + x] = 0;
+                }
+                continue;
+            }
+
+            const Vector* v_c = vel + row;
+            const Vector* v_p = v_c + nx; // y+1
+            const Vector* v_n = v_c - nx; // y-1
+
+            #pragma omp simd
+            for(std::int32_t x=1; x<nx-1; ++x)
+            {
+                const double dudx = 0.5 * (v_c[x+1].x - v_c[x-1].x);
+                const double dvdx = 0.5 * (v_c[x+1].y - v_c[x-1].y);
+                const double dudy = 0.5 * (v_p[x].x - v_n[x].x);
+                const double dvdy = 0.5 * (v_p[x].y - v_n[x].y);
+
+                const double omega = dvdx - dudy;
+                const double shear = dudy + dvdx;
+                const double s2    = dudx * dudx + dvdy * dvdy + 0.5 * shear * shear; // S:S
+                const double w2    = 0.5 * omega * omega;                             // W:W
+
+                vort  [row + x] = omega;
+                q     [row + x] = 0.5 * (w2 - s2);
+                strain[row + x] = std::sqrt(2.0 * s2);
+            }
+            for(const std::int32_t x : {0, nx-1})
+            {
+                vort  [row + x] = 0;
+                q     [row + x] = 0;
+                strain[row + x] = 0;
+            }
+        }
+        return;
+    }
+
+    std::int32_t size_x() const noexcept {return nx_;}
+    std::int32_t size_y() const noexcept {return ny_;}
+
+    // row-major, y * size_x() + x
+    std::vector<double> const& vorticity()   const noexcept {return vorticity_;}
+    std::vector<double> const& speed()       const noexcept {return speed_;}
+    std::vector<double> const& q_criterion() const noexcept {return q_criterion_;}
+    std::vector<double> const& strain_rate() const noexcept {return strain_rate_;}
+
+    double vorticity_at  (std::int32_t x, std::int32_t y) const {return vorticity_  .at(y * nx_ + x);}
+    double speed_at      (std::int32_t x, std::int32_t y) const {return speed_      .at(y * nx_ + x);}
+    double q_criterion_at(std::int32_t x, std::int32_t y) const {return q_criterion_.at(y * nx_ + x);}
+    double strain_rate_at(std::int32_t x, std::int32_t y) const {return strain_rate_.at(y * nx_ + x);}
+
+  private:
+
+    void resize(std::int32_t nx, std::int32_t ny)
+    {
+        if(nx == nx_ && ny == ny_) {return;}
+
+        nx_ = nx;
+        ny_ = ny;
+        const std::size_t n = static_cast<std::size_t>(nx) * ny;
+        vorticity_  .resize(n);
+        speed_      .resize(n);
+        q_criterion_.resize(n);
+        strain_rate_.resize(n);
+        return;
+    }
+
+  private:
+
+    std::int32_t nx_;
+    std::int32_t ny_;
+    std::vector<double> vorticity_;
+    std::vector<double> speed_;
+    std::vector<double> q_criterion_;
+    std::vector<double> strain_rate_;
+};
+
+} // lbm
+#endif // LATTICE_BOLTZMANN_FIELDS_HPP
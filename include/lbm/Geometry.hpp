@@ -0,0 +1,256 @@
+#ifndef LATTICE_BOLTZMANN_GEOMETRY_HPP
+#define LATTICE_BOLTZMANN_GEOMETRY_HPP
+
+// Cell classification of a whole World, built in code or read from a file.
+//
+// Supported files (row 0 of the image is y = 0, as in Window):
+//  - PBM (P1, P4): black (1) is Barrier, white (0) is fluid.
+//  - PGM (P2, P5): dark (< maxval/3) is Barrier, light (> 2 maxval/3) is
+//    fluid and the gray in between is ConstantFlow.
+//  - text voxel files: a line "nx ny" followed by ny lines of nx characters,
+//    '.' for fluid, '#' for Barrier and 'C' for ConstantFlow.
+
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <cctype>
+#include <cstdint>
+
+namespace lbm
+{
+
+enum class CellKind : std::uint8_t
+{
+    Fluid    = 0,
+    Barrier  = 1,
+    Boundary = 2, // ConstantFlow
+};
+
+struct Geometry
+{
+  public:
+
+    Geometry(std::int32_t nx, std::int32_t ny, CellKind k = CellKind::Fluid)
+        : nx_(nx), ny_(ny), cells_(static_cast<std::size_t>(nx) * ny, k)
+    {}
+
+    CellKind at(std::int32_t x, std::int32_t y) const {return cells_.at(idx_of(x, y));}
+    void set(std::int32_t x, std::int32_t y, CellKind k) {cells_.at(idx_of(x, y)) = k;}
+
+    // set the outermost ring of cells, e.g. to put ConstantFlow around the domain
+    void set_edges(CellKind k)
+    {
+        for(std::int32_t x=0; x<nx_; ++x)
+        {
+            this->set(x, 0,     k);
+            this->set(x, ny_-1, k);
+        }
+        for(std::int32_t y=0; y<ny_; ++y)
+        {
+            this->set(0,     y, k);
+            this->set(nx_-1, y, k);
+        }
+        return;
+    }
+
+    std::int32_t size_x() const noexcept {return nx_;}
+    std::int32_t size_y() const noexcept {return ny_;}
+
+    // row-major, y * size_x() + x
+    std::vector<CellKind> const& cells() const noexcept {return cells_;}
+
+  private:
+
+    std::size_t idx_of(std::int32_t x, std::int32_t y) const noexcept
+    {
+        return static_cast<std::size_t>(y) * nx_ + x;
+    }
+
+  private:
+
+    std::int32_t nx_;
+    std::int32_t ny_;
+    std::vector<CellKind> cells_;
+};
+
+namespace geometry_detail
+{
+// reads the whitespace-separated header fields of Netpbm, skipping comments
+struct Scanner
+{
+    const std::string& buf;
+    std::size_t pos;
+
+    void skip_space()
+    {
+        while(pos < buf.size())
+        {
+            if(buf[pos] == '#')
+            {
+                while(pos < buf.size() && buf[pos] != '\n') {++pos;}
+            }
+            else if(std::isspace(static_cast<unsigned char>(buf[pos])))
+            {
+                ++pos;
+            }
+            else
+            {
+                break;
+            }
+        }
+    }
+    std::uint32_t number()
+    {
+        this->skip_space();
+        if(pos == buf.size() || ! std::isdigit(static_cast<unsigned char>(buf[pos])))
+        {
+            throw std::runtime_error("lbm::load_geometry: malformed file");
+        }
+        std::uint32_t v = 0;
+        while(pos < buf.size() && std::isdigit(static_cast<unsigned char>(buf[pos])))
+        {
+            v = v * 10 + static_cast<std::uint32_t>(buf[pos] - '0');
+            ++pos;
+        }
+        return v;
+    }
+    // the next '0' or '1' (plain PBM allows them without separators)
+    std::uint32_t bit()
+    {
+        this->skip_space();
+        if(pos == buf.size() || (buf[pos] != '0' && buf[pos] != '1'))
+        {
+            throw std::runtime_error("lbm::load_geometry: malformed PBM");
+        }
+        return static_cast<std::uint32_t>(buf[pos++] - '0');
+    }
+};
+
+inline Geometry read_netpbm(const std::string& buf)
+{
+    Scanner sc{buf, 2};
+    const char format = buf[1];
+    const auto nx = static_cast<std::int32_t>(sc.number());
+    const auto ny = static_cast<std::int32_t>(sc.number());
+    const std::uint32_t maxval = (format == '1' || format == '4') ? 1 : sc.number();
+    if(nx <= 0 || ny <= 0 || maxval == 0 || 65535 < maxval)
+    {
+        throw std::runtime_error("lbm::load_geometry: invalid image header");
+    }
+
+    Geometry g(nx, ny);
+    const auto gray = [maxval](const std::uint32_t v) {
+        if(3 * v <     maxval) {return CellKind::Barrier;}
+        if(3 * v > 2 * maxval) {return CellKind::Fluid;}
+        return CellKind::Boundary;
+    };
+
+    if(format == '1' || format == '2') // plain
+    {
+        for(std::int32_t y=0; y<ny; ++y)
+        {
+            for(std::int32_t x=0; x<nx; ++x)
+            {
+                g.set(x, y, (format == '1') ?
+                        (sc.bit() ? CellKind::Barrier : CellKind::Fluid) : gray(sc.number()));
+            }
+        }
+        return g;
+    }
+
+    // raw: a single whitespace after the header, then the data
+    const std::size_t first = sc.pos + 1;
+    if(format == '4')
+    {
+        const std::size_t row_bytes = (nx + 7) / 8;
+        if(buf.size() < first + row_bytes * ny)
+        {
+            throw std::runtime_error("lbm::load_geometry: truncated PBM");
+        }
+        for(std::int32_t y=0; y<ny; ++y)
+        {
+            const auto* row = reinterpret_cast<const unsigned char*>(buf.data() + first + row_bytes * y);
+            for(std::int32_t x=0; x<nx; ++x)
+            {
+                const bool black = (row[x / 8] >> (7 - x % 8)) & 1;
+                g.set(x, y, black ? CellKind::Barrier : CellKind::Fluid);
+            }
+        }
+        return g;
+    }
+
+    const std::size_t bytes = (maxval < 256) ? 1 : 2;
+    if(buf.size() < first + bytes * nx * ny)
+    {
+        throw std::runtime_error("lbm::load_geometry: truncated PGM");
+    }
+    const auto* data = reinterpret_cast<const unsigned char*>(buf.data() + first);
+    for(std::int32_t y=0; y<ny; ++y)
+    {
+        for(std::int32_t x=0; x<nx; ++x)
+        {
+            const std::size_t i = static_cast<std::size_t>(y) * nx + x;
+            const std::uint32_t v = (bytes == 1) ? data[i] : (data[2*i] << 8 | data[2*i+1]);
+            g.set(x, y, gray(v));
+        }
+    }
+    return g;
+}
+
+inline Geometry read_voxels(const std::string& buf)
+{
+    Scanner sc{buf, 0};
+    const auto nx = static_cast<std::int32_t>(sc.number());
+    const auto ny = static_cast<std::int32_t>(sc.number());
+    if(nx <= 0 || ny <= 0)
+    {
+        throw std::runtime_error("lbm::load_geometry: invalid voxel header");
+    }
+
+    Geometry g(nx, ny);
+    std::size_t pos = sc.pos;
+    for(std::int32_t y=0; y<ny; ++y)
+    {
+        for(std::int32_t x=0; x<nx; ++x)
+        {
+            while(pos < buf.size() && std::isspace(static_cast<unsigned char>(buf[pos]))) {++pos;}
+            if(pos == buf.size())
+            {
+                throw std::runtime_error("lbm::load_geometry: truncated voxel file");
+            }
+            switch(buf[pos++])
+            {
+                case '.': { g.set(x, y, CellKind::Fluid);    break; }
+                case '#': { g.set(x, y, CellKind::Barrier);  break; }
+                case 'C': { g.set(x, y, CellKind::Boundary); break; }
+                default:
+                {
+                    throw std::runtime_error("lbm::load_geometry: unknown voxel character");
+                }
+            }
+        }
+    }
+    return g;
+}
+} // geometry_detail
+
+inline Geometry load_geometry(const std::string& filename)
+{
+    std::ifstream ifs(filename, std::ios::binary);
+    if( ! ifs.good())
+    {
+        throw std::runtime_error("lbm::load_geometry: cannot open " + filename);
+    }
+    const std::string buf{std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+
+    if(2 <= buf.size() && buf[0] == 'P' && '1' <= buf[1] && buf[1] <= '5' && buf[1] != '3')
+    {
+        return geometry_detail::read_netpbm(buf);
+    }
+    return geometry_detail::read_voxels(buf);
+}
+
+} // lbm
+#endif // LATTICE_BOLTZMANN_GEOMETRY_HPP
@@ -7,6 +7,7 @@
 
 #include <variant>
 #include <array>
+#include <cstdint>
 
 namespace lbm
 {
@@ -38,6 +39,21 @@ struct Grid final : public GridBase
         return;
     }
 
+    // every kind stores 9 plain populations, so they are handed out after a
+    // check of the index instead of a std::visit per population
+    std::array<double, 9>& populations() noexcept
+    {
+        if(auto* c = std::get_if<Cell>   (&grid_)) {return c->populations();}
+        if(auto* b = std::get_if<Barrier>(&grid_)) {return b->populations();}
+        return std::get_if<ConstantFlow>(&grid_)->populations();
+    }
+    std::array<double, 9> const& populations() const noexcept
+    {
+        if(const auto* c = std::get_if<Cell>   (&grid_)) {return c->populations();}
+        if(const auto* b = std::get_if<Barrier>(&grid_)) {return b->populations();}
+        return std::get_if<ConstantFlow>(&grid_)->populations();
+    }
+
     bool bounces() const noexcept override
     {
         return std::visit([](const auto& g) {return g.bounces();}, grid_);
@@ -60,8 +76,16 @@ struct Grid final : public GridBase
         return std::visit([rho](const auto& g) {return g.velocity(rho);}, grid_);
     }
 
-    bool is_cell()    const noexcept {return grid_.index() == 0;}
-    bool is_barrier() const noexcept {return grid_.index() == 1;}
+    bool is_cell()     const noexcept {return grid_.index() == 0;}
+    bool is_barrier()  const noexcept {return grid_.index() == 1;}
+    bool is_boundary() const noexcept {return grid_.index() == 2;}
+
+    // index of the BoundaryCondition of a ConstantFlow cell
+    std::uint32_t condition() const noexcept
+    {
+        const auto* c = std::get_if<ConstantFlow>(&grid_);
+        return (c != nullptr) ? c->condition() : 0;
+    }
 
   private:
 
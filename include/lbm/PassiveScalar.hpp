@@ -0,0 +1,192 @@
+#ifndef LATTICE_BOLTZMANN_PASSIVE_SCALAR_HPP
+#define LATTICE_BOLTZMANN_PASSIVE_SCALAR_HPP
+
+#include "Direction.hpp"
+#include "Vector.hpp"
+
+#include <array>
+#include <cassert>
+#include <vector>
+#include <cstdint>
+
+namespace lbm
+{
+
+// D2Q5 lattice constants, indexed in the order of `dirs`
+namespace d2q5
+{
+inline constexpr std::array<Direction, 5> dirs{{
+    Direction::Self, Direction::Right, Direction::Up, Direction::Left, Direction::Down
+}};
+inline constexpr std::array<std::int32_t, 5> cx{{0, 1, 0, -1,  0}};
+inline constexpr std::array<std::int32_t, 5> cy{{0, 0, 1,  0, -1}};
+inline constexpr std::array<std::size_t,  5> opposite{{0, 3, 4, 1, 2}};
+inline constexpr std::array<double, 5> weight{{1/3.0, 1/6.0, 1/6.0, 1/6.0, 1/6.0}};
+
+inline double equilibrium(const std::size_t q, const double c, const Vector u)
+{
+    return weight[q] * c * (1 + 3 * (cx[q] * u.x + cy[q] * u.y));
+}
+} // d2q5
+
+// A passive scalar (temperature, concentration) transported by the flow of a
+// World, on a D2Q5 lattice with a BGK collision. The velocity is not stored;
+// World calls stream() from its streaming loop and collide() from the loop
+// that computes u, handing over the freshly computed velocity of the cell.
+//
+// Like the flow, each cell is either
+//  - Fluid : advected and diffused,
+//  - Wall  : no flux. populations hitting it are bounced back (cf. Barrier),
+//  - Fixed : the scalar is kept at a fixed value (cf. ConstantFlow).
+// Populations coming from outside of the lattice are bounced back as well.
+struct PassiveScalar
+{
+  public:
+
+    enum class Kind : std::uint8_t {Fluid, Wall, Fixed};
+
+    PassiveScalar(std::int32_t nx, std::int32_t ny, const double diffusivity)
+        : nx_(nx), ny_(ny), diffusivity_(diffusivity),
+          omega_(1.0 / (3.0 * diffusivity + 0.5)),
+          kind_ (nx * ny, Kind::Fluid),
+          fixed_(nx * ny, 0.0),
+          value_(nx * ny, 0.0)
+    {
+        for(std::size_t q=0; q<5; ++q)
+        {
+            populations_[q].assign(nx * ny, 0.0);
+            buffer_     [q].assign(nx * ny, 0.0);
+        }
+    }
+
+    void initialize(std::int32_t x, std::int32_t y, const double c, const Vector u)
+    {
+        const auto i = idx_of(x, y);
+        this->value_.at(i) = c;
+        for(std::size_t q=0; q<5; ++q)
+        {
+            this->populations_[q].at(i) = d2q5::equilibrium(q, c, u);
+        }
+    }
+
+    void set_wall(std::int32_t x, std::int32_t y)
+    {
+        const auto i = idx_of(x, y);
+        this->kind_.at(i)  = Kind::Wall;
+        this->value_.at(i) = 0;
+        for(std::size_t q=0; q<5; ++q)
+        {
+            this->populations_[q].at(i) = 0;
+        }
+    }
+    // turn a Wall or Fixed cell back into an empty Fluid cell
+    void set_fluid(std::int32_t x, std::int32_t y)
+    {
+        const auto i = idx_of(x, y);
+        this->kind_.at(i) = Kind::Fluid;
+        this->initialize(x, y, 0, Vector{0, 0});
+    }
+    void set_fixed(std::int32_t x, std::int32_t y, const double c, const Vector u = Vector{0, 0})
+    {
+        const auto i = idx_of(x, y);
+        this->kind_ .at(i) = Kind::Fixed;
+        this->fixed_.at(i) = c;
+        this->initialize(x, y, c, u);
+    }
+
+    // pull the post-collision populations into the cell (x, y)
+    void stream(const std::int32_t x, const std::int32_t y) noexcept
+    {
+        const auto i = idx_of(x, y);
+        if(kind_[i] == Kind::Wall) {return;}
+
+        for(std::size_t q=0; q<5; ++q)
+        {
+            const std::int32_t sx = x - d2q5::cx[q];
+            const std::int32_t sy = y - d2q5::cy[q];
+            const bool outside = (sx < 0 || nx_ <= sx || sy < 0 || ny_ <= sy);
+
+            if(outside || kind_[idx_of(sx, sy)] == Kind::Wall)
+            {
+                buffer_[q][i] = populations_[d2q5::opposite[q]][i];
+            }
+            else
+            {
+                buffer_[q][i] = populations_[q][idx_of(sx, sy)];
+            }
+        }
+        return;
+    }
+    // called once all the cells are streamed
+    void swap() noexcept
+    {
+        std::swap(this->populations_, this->buffer_);
+    }
+
+    // update the scalar of cell i and relax it toward the equilibrium with u
+    void collide(const std::size_t i, const Vector u) noexcept
+    {
+        assert(i < kind_.size());
+        switch(kind_[i])
+        {
+            case Kind::Wall: {return;}
+            case Kind::Fixed:
+            {
+                value_[i] = fixed_[i];
+                for(std::size_t q=0; q<5; ++q)
+                {
+                    populations_[q][i] = d2q5::equilibrium(q, fixed_[i], u);
+                }
+                return;
+            }
+            default: break;
+        }
+
+        double c = 0;
+        for(std::size_t q=0; q<5; ++q)
+        {
+            c += populations_[q][i];
+        }
+        value_[i] = c;
+        for(std::size_t q=0; q<5; ++q)
+        {
+            auto& g = populations_[q][i];
+            g += omega_ * (d2q5::equilibrium(q, c, u) - g);
+        }
+        return;
+    }
+
+    double value_at(std::int32_t x, std::int32_t y) const {return value_.at(idx_of(x, y));}
+    Kind   kind_at (std::int32_t x, std::int32_t y) const {return kind_ .at(idx_of(x, y));}
+
+    // row-major, y * size_x() + x
+    std::vector<double> const& values() const noexcept {return value_;}
+
+    std::int32_t size_x()      const noexcept {return nx_;}
+    std::int32_t size_y()      const noexcept {return ny_;}
+    double       diffusivity() const noexcept {return diffusivity_;}
+
+  private:
+
+    std::size_t idx_of(std::int32_t x, std::int32_t y) const noexcept
+    {
+        assert(0 <= x && x < nx_ && 0 <= y && y < ny_);
+        return static_cast<std::size_t>(y) * nx_ + x;
+    }
+
+  private:
+
+    std::int32_t nx_;
+    std::int32_t ny_;
+    double diffusivity_;
+    double omega_;
+
+    std::vector<Kind>   kind_;
+    std::vector<double> fixed_;  // value at Fixed cells
+    std::vector<double> value_;  // scalar after the last step
+    std::array<std::vector<double>, 5> populations_; // [q][cell], post-collision
+    std::array<std::vector<double>, 5> buffer_;
+};
+
+} // lbm
+#endif // LATTICE_BOLTZMANN_PASSIVE_SCALAR_HPP
@@ -0,0 +1,304 @@
+#ifndef LATTICE_BOLTZMANN_PROFILER_HPP
+#define LATTICE_BOLTZMANN_PROFILER_HPP
+
+// Phase-level instrumentation.
+//
+// Use the LBM_PROFILE_* macros in the code. Unless LBM_ENABLE_PROFILING is
+// defined (cmake -DLBM_ENABLE_PROFILING=ON) they expand to nothing, so the
+// instrumented code costs nothing in normal builds.
+//
+// Each thread appends its events to its own log, so recording does not lock.
+// A log keeps the latest `capacity()` events and counters and overwrites the
+// oldest ones, so long runs do not grow without bound; the per-phase totals
+// are accumulated separately and cover the whole run. The events can be
+// written in the Chrome trace-event format (open it in chrome://tracing or
+// https://ui.perfetto.dev) or as a JSON summary with the total time and bytes
+// per phase and per thread.
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+namespace lbm
+{
+
+struct Profiler
+{
+  public:
+
+    struct Event
+    {
+        const char*   name;
+        std::int64_t  begin; // [ns] since the profiler started
+        std::int64_t  end;   // [ns]
+        std::uint64_t bytes; // estimated memory traffic. 0 if unknown
+    };
+    struct Counter
+    {
+        const char*  name;
+        std::int64_t time;   // [ns]
+        double       value;
+    };
+    // total time and bytes of a phase
+    struct Total
+    {
+        std::size_t   calls = 0;
+        std::int64_t  time  = 0; // [ns]
+        std::uint64_t bytes = 0;
+    };
+
+    // keeps the latest `capacity` elements
+    template<typename T>
+    struct Ring
+    {
+        std::vector<T> data;
+        std::size_t    head = 0; // the oldest element once `data` is full
+
+        void push(const T& x, const std::size_t capacity)
+        {
+            if(data.size() < capacity)
+            {
+                data.push_back(x);
+                return;
+            }
+            if(capacity == 0) {return;}
+            data[head] = x;
+            head = (head + 1) % data.size();
+        }
+        template<typename F>
+        void for_each(F&& f) const // oldest first
+        {
+            for(std::size_t i=0; i<data.size(); ++i)
+            {
+                f(data[(head + i) % data.size()]);
+            }
+        }
+        void clear()
+        {
+            data.clear();
+            head = 0;
+        }
+    };
+
+    struct ThreadLog
+    {
+        std::size_t    tid;
+        Ring<Event>    events;
+        Ring<Counter>  counters;
+        std::unordered_map<const char*, Total> totals; // names are literals
+    };
+
+    static Profiler& instance()
+    {
+        static Profiler p;
+        return p;
+    }
+
+    std::int64_t now() const noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start_).count();
+    }
+
+    // the log of the calling thread. registered on the first call
+    ThreadLog& log()
+    {
+        thread_local ThreadLog* local = nullptr;
+        if(local == nullptr)
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            logs_.push_back(std::make_unique<ThreadLog>());
+            logs_.back()->tid = logs_.size() - 1;
+            local = logs_.back().get();
+        }
+        return *local;
+    }
+
+    void record(const char* name, std::int64_t begin, std::int64_t end, std::uint64_t bytes)
+    {
+        auto& l = this->log();
+        l.events.push(Event{name, begin, end, bytes}, capacity_);
+
+        auto& t = l.totals[name];
+        t.calls += 1;
+        t.time  += end - begin;
+        t.bytes += bytes;
+    }
+    void count(const char* name, double value)
+    {
+        this->log().counters.push(Counter{name, this->now(), value}, capacity_);
+    }
+
+    // the number of events (and counters) kept per thread for the trace.
+    // must not be called while other threads are recording
+    void set_capacity(const std::size_t n)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        this->capacity_ = n;
+        for(auto& l : logs_)
+        {
+            l->events  .clear();
+            l->counters.clear();
+        }
+    }
+    std::size_t capacity() const noexcept {return capacity_;}
+
+    // drop all events. must not be called while other threads are recording
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        for(auto& l : logs_)
+        {
+            l->events  .clear();
+            l->counters.clear();
+            l->totals  .clear();
+        }
+        return;
+    }
+
+    // {"traceEvents": [...]}. timestamps are in microseconds
+    void write_chrome_trace(std::ostream& os) const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+
+        os << "{\"traceEvents\":[\n";
+        bool first = true;
+        const auto sep = [&os, &first]() {
+            if( ! first) {os << ",\n";}
+            first = false;
+        };
+        for(const auto& l : logs_)
+        {
+            sep();
+            os << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << l->tid
+               << ",\"args\":{\"name\":\"thread " << l->tid << "\"}}";
+
+            l->events.for_each([&](const Event& e) {
+                sep();
+                os << "{\"name\":\"" << e.name << "\",\"cat\":\"lbm\",\"ph\":\"X\",\"pid\":0,\"tid\":" << l->tid
+                   << ",\"ts\":";
+                write_us(os, e.begin);
+                os << ",\"dur\":";
+                write_us(os, e.end - e.begin);
+                if(e.bytes != 0)
+                {
+                    os << ",\"args\":{\"bytes\":" << e.bytes << '}';
+                }
+                os << '}';
+            });
+            l->counters.for_each([&](const Counter& c) {
+                sep();
+                os << "{\"name\":\"" << c.name << "\",\"ph\":\"C\",\"pid\":0,\"tid\":" << l->tid
+                   << ",\"ts\":";
+                write_us(os, c.time);
+                os << ",\"args\":{\"value\":" << c.value << "}}";
+            });
+        }
+        os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+        return;
+    }
+
+    // {"phases": [{"name", "thread", "calls", "total_ms", "bytes", "GB/s"}, ...]}
+    void write_summary(std::ostream& os) const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+
+        std::map<std::pair<std::string, std::size_t>, Total> totals;
+        for(const auto& l : logs_)
+        {
+            for(const auto& [name, lt] : l->totals)
+            {
+                auto& t = totals[std::make_pair(std::string(name), l->tid)];
+                t.calls += lt.calls;
+                t.time  += lt.time;
+                t.bytes += lt.bytes;
+            }
+        }
+
+        os << "{\"phases\":[\n";
+        bool first = true;
+        for(const auto& [key, t] : totals)
+        {
+            if( ! first) {os << ",\n";}
+            first = false;
+
+            const double sec = t.time * 1e-9;
+            os << "{\"name\":\"" << key.first << "\",\"thread\":" << key.second
+               << ",\"calls\":" << t.calls << ",\"total_ms\":" << t.time * 1e-6
+               << ",\"bytes\":" << t.bytes
+               << ",\"GB/s\":" << ((0 < sec) ? t.bytes / sec * 1e-9 : 0.0) << '}';
+        }
+        os << "\n]}\n";
+        return;
+    }
+
+  private:
+
+    Profiler(): start_(std::chrono::steady_clock::now()), capacity_(1 << 16) {}
+
+    // [ns] -> [us] with 3 decimals, exact at any run time
+    static void write_us(std::ostream& os, const std::int64_t ns)
+    {
+        const char fill = os.fill('0');
+        os << ns / 1000 << '.' << std::setw(3) << ns % 1000;
+        os.fill(fill);
+        return;
+    }
+
+  private:
+
+    std::chrono::steady_clock::time_point start_;
+    std::size_t capacity_; // events per thread
+    mutable std::mutex mtx_;
+    std::vector<std::unique_ptr<ThreadLog>> logs_;
+};
+
+// records the time between construction and destruction as an event
+struct ScopedTimer
+{
+    explicit ScopedTimer(const char* name, std::uint64_t bytes = 0)
+        : name_(name), bytes_(bytes), begin_(Profiler::instance().now())
+    {}
+    ~ScopedTimer()
+    {
+        auto& prof = Profiler::instance();
+        prof.record(name_, begin_, prof.now(), bytes_);
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+  private:
+    const char*   name_;
+    std::uint64_t bytes_;
+    std::int64_t  begin_;
+};
+
+} // lbm
+
+#define LBM_PROFILE_CONCAT_IMPL(a, b) a##b
+#define LBM_PROFILE_CONCAT(a, b) LBM_PROFILE_CONCAT_IMPL(a, b)
+
+#ifdef LBM_ENABLE_PROFILING
+#  define LBM_PROFILE_SCOPE(name) \
+    const ::lbm::ScopedTimer LBM_PROFILE_CONCAT(lbm_profile_scope_, __LINE__)(name)
+#  define LBM_PROFILE_SCOPE_BYTES(name, bytes) \
+    const ::lbm::ScopedTimer LBM_PROFILE_CONCAT(lbm_profile_scope_, __LINE__)(name, bytes)
+#  define LBM_PROFILE_COUNT(name, value) \
+    ::lbm::Profiler::instance().count(name, value)
+#else
+#  define LBM_PROFILE_SCOPE(name)              ((void)0)
+#  define LBM_PROFILE_SCOPE_BYTES(name, bytes) ((void)0)
+#  define LBM_PROFILE_COUNT(name, value)       ((void)0)
+#endif
+
+#endif // LATTICE_BOLTZMANN_PROFILER_HPP
@@ -0,0 +1,398 @@
+#ifndef LATTICE_BOLTZMANN_REFINEMENT_HPP
+#define LATTICE_BOLTZMANN_REFINEMENT_HPP
+
+// Static multi-level grid refinement.
+//
+// A RefinementPatch covers a rectangle of its parent lattice with a World of
+// twice the resolution. With the acoustic scaling (dx and dt both halved) the
+// lattice velocity and density are the same on both levels and the lattice
+// viscosity doubles, so the patch runs BGK(2 nu) and takes two sub-steps per
+// parent step.
+//
+// Coupling (Dupuis & Chopard):
+//  - parent -> patch: before each sub-step the outermost ring of the patch is
+//    set to feq(rho, u) + (tau_f / 2 tau_c) fneq, where rho, u and fneq are
+//    interpolated from the parent, bilinearly in space and linearly in time
+//    between the parent states before and after the parent step.
+//  - patch -> parent: after the two sub-steps, the parent cells inside the
+//    patch (except a margin of one parent cell next to the interface) are
+//    replaced by the average of their 2x2 fine cells, with the
+//    non-equilibrium part scaled back by (2 tau_c / tau_f).
+//
+// Patches can be nested; a child region is given in the cells of its parent
+// patch. Barrier cells of the parent are copied into the patch as 2x2 blocks
+// and can be refined further through RefinementPatch::world().
+
+#include "BGK.hpp"
+#include "Direction.hpp"
+#include "World.hpp"
+#include "Vector.hpp"
+
+#include <array>
+#include <list>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+namespace lbm
+{
+
+// [x0, x0 + width) x [y0, y0 + height) in the cells of the parent
+struct RefinementRegion
+{
+    std::int32_t x0;
+    std::int32_t y0;
+    std::int32_t width;
+    std::int32_t height;
+};
+
+struct RefinementPatch
+{
+  public:
+
+    RefinementPatch(const World& parent, RefinementRegion r)
+        : region_(r),
+          fine_(2 * r.width, 2 * r.height, BGK(2.0 * parent.model().viscosity())),
+          tau_c_(1.0 / parent.model().omega()),
+          tau_f_(1.0 / fine_.model().omega())
+    {
+        // the interpolation stencil needs one parent cell around the region,
+        // and that cell should not be a boundary of the parent
+        if(r.width < 3 || r.height < 3 || r.x0 < 2 || r.y0 < 2 ||
+           parent.size_x() - 2 < r.x0 + r.width || parent.size_y() - 2 < r.y0 + r.height)
+        {
+            throw std::invalid_argument("lbm::RefinementPatch: region must be at least 3x3 "
+                                        "and 2 cells away from the edge of the parent");
+        }
+
+        this->capture(parent, old_);
+        for(std::int32_t j=0; j<fine_.size_y(); ++j)
+        {
+            for(std::int32_t i=0; i<fine_.size_x(); ++i)
+            {
+                const auto px = r.x0 + i / 2;
+                const auto py = r.y0 + j / 2;
+                const auto moments = parent.at(px, py).is_barrier() ? std::nullopt :
+                                     this->interpolate_moments(old_, i, j);
+                if( ! moments)
+                {
+                    fine_.set_grid(i, j, Barrier());
+                }
+                else
+                {
+                    fine_.initialize(i, j, moments->first, moments->second);
+                }
+            }
+        }
+    }
+
+    // add a nested patch. `r` is in the cells of this patch
+    RefinementPatch& refine(RefinementRegion r)
+    {
+        this->children_.emplace_back(fine_, r);
+        return this->children_.back();
+    }
+
+    // called before the parent steps
+    void begin_step(const World& parent)
+    {
+        this->capture(parent, old_);
+    }
+
+    // called after the parent stepped. advances this patch by two sub-steps
+    // and writes the result back into the parent
+    void end_step(World& parent)
+    {
+        this->capture(parent, new_);
+
+        for(std::int32_t sub=0; sub<2; ++sub)
+        {
+            this->impose_interface(0.5 * sub);
+            for(auto& child : children_)
+            {
+                child.begin_step(fine_);
+            }
+            fine_.step();
+            for(auto& child : children_)
+            {
+                child.end_step(fine_);
+            }
+        }
+        this->restrict_to(parent);
+        return;
+    }
+
+    World const& world() const noexcept {return fine_;}
+    World&       world()       noexcept {return fine_;}
+
+    RefinementRegion const& region() const noexcept {return region_;}
+    std::list<RefinementPatch> const& children() const noexcept {return children_;}
+
+  private:
+
+    // rho, u and fneq of the parent over the region and one cell around it
+    struct ParentState
+    {
+        std::vector<double> rho;
+        std::vector<Vector> u;
+        std::vector<std::array<double, 9>> neq;
+        std::vector<std::uint8_t> solid; // Barrier, left out of interpolation
+    };
+
+    std::int32_t halo_x() const noexcept {return region_.width  + 2;}
+    std::int32_t halo_y() const noexcept {return region_.height + 2;}
+
+    void capture(const World& parent, ParentState& s) const
+    {
+        const std::size_t n = static_cast<std::size_t>(halo_x()) * halo_y();
+        s.rho.resize(n);
+        s.u  .resize(n);
+        s.neq.resize(n);
+        s.solid.resize(n);
+
+        for(std::int32_t hy=0; hy<halo_y(); ++hy)
+        {
+            for(std::int32_t hx=0; hx<halo_x(); ++hx)
+            {
+                const auto px = region_.x0 - 1 + hx;
+                const auto py = region_.y0 - 1 + hy;
+                const auto k  = static_cast<std::size_t>(hy) * halo_x() + hx;
+
+                const auto& g = parent.at(px, py);
+                s.solid[k] = g.is_barrier();
+                s.rho[k] = parent.density_at (px, py);
+                s.u  [k] = parent.velocity_at(px, py);
+                for(std::size_t q=0; q<9; ++q)
+                {
+                    s.neq[k][q] = g.is_barrier() ? 0.0 :
+                        g.distribution(static_cast<Direction>(q)) -
+                        d2q9::equilibrium(q, s.rho[k], s.u[k].x, s.u[k].y);
+                }
+            }
+        }
+        return;
+    }
+
+    // bilinear weights of the fine cell (i, j) in the halo array. Barrier
+    // cells have no fluid state, so they are dropped and the weights of the
+    // others renormalized. the parent cell that contains (i, j) always has a
+    // nonzero weight, but once Barriers are edited (in the parent or through
+    // world()) a fluid fine cell can have only Barrier parents; then there is
+    // nothing to interpolate and nullopt is returned
+    struct Stencil
+    {
+        std::array<std::size_t, 4> k;
+        std::array<double, 4>      w;
+    };
+    std::optional<Stencil> stencil(std::int32_t i, std::int32_t j, const std::vector<std::uint8_t>& solid) const noexcept
+    {
+        auto st = this->bilinear(i, j);
+        double sum = 0;
+        for(std::size_t n=0; n<4; ++n)
+        {
+            if(solid[st.k[n]]) {st.w[n] = 0;}
+            sum += st.w[n];
+        }
+        if(sum == 0)
+        {
+            return std::nullopt;
+        }
+        for(auto& w : st.w)
+        {
+            w /= sum;
+        }
+        return st;
+    }
+    Stencil bilinear(std::int32_t i, std::int32_t j) const noexcept
+    {
+        // the fine cell i is centered at x0 + (i - 0.5) / 2 in parent cells,
+        // that is (i + 1.5) / 2 in the halo array
+        const double hx = 0.5 * (i + 1.5);
+        const double hy = 0.5 * (j + 1.5);
+        const auto   ix = static_cast<std::int32_t>(hx);
+        const auto   iy = static_cast<std::int32_t>(hy);
+        const double fx = hx - ix;
+        const double fy = hy - iy;
+
+        const auto k00 = static_cast<std::size_t>(iy) * halo_x() + ix;
+        return Stencil{
+            {{k00, k00 + 1, k00 + halo_x(), k00 + halo_x() + 1}},
+            {{(1-fx)*(1-fy), fx*(1-fy), (1-fx)*fy, fx*fy}}
+        };
+    }
+
+    std::optional<std::pair<double, Vector>>
+    interpolate_moments(const ParentState& s, std::int32_t i, std::int32_t j) const
+    {
+        const auto stencil = this->stencil(i, j, s.solid);
+        if( ! stencil) {return std::nullopt;}
+
+        const auto& st = *stencil;
+        double rho = 0;
+        Vector u{0, 0};
+        for(std::size_t n=0; n<4; ++n)
+        {
+            rho = rho + st.w[n] * s.rho[st.k[n]];
+            u   = u   + st.w[n] * s.u  [st.k[n]];
+        }
+        return std::make_pair(rho, u);
+    }
+
+    // set the outermost ring of the patch from the parent state at the
+    // fraction `t` of the parent step
+    void impose_interface(const double t)
+    {
+        const double scale = tau_f_ / (2.0 * tau_c_);
+        const auto nx = fine_.size_x();
+        const auto ny = fine_.size_y();
+
+        const auto impose = [&](std::int32_t i, std::int32_t j) {
+            if(fine_.at(i, j).is_barrier()) {return;}
+
+            // Barriers do not change during a parent step, so old_ has them.
+            // without a fluid parent the cell is left to the fine lattice
+            const auto stencil = this->stencil(i, j, old_.solid);
+            if( ! stencil) {return;}
+
+            const auto& st = *stencil;
+            double rho = 0;
+            Vector u{0, 0};
+            std::array<double, 9> neq{};
+            for(std::size_t n=0; n<4; ++n)
+            {
+                const auto k = st.k[n];
+                const auto w = st.w[n];
+                rho = rho + w * ((1-t) * old_.rho[k] + t * new_.rho[k]);
+                u   = u   + w * ((1-t) * old_.u  [k] + t * new_.u  [k]);
+                for(std::size_t q=0; q<9; ++q)
+                {
+                    neq[q] += w * ((1-t) * old_.neq[k][q] + t * new_.neq[k][q]);
+                }
+            }
+            std::array<double, 9> f;
+            for(std::size_t q=0; q<9; ++q)
+            {
+                f[q] = d2q9::equilibrium(q, rho, u.x, u.y) + scale * neq[q];
+            }
+            fine_.assign(i, j, f);
+        };
+
+        for(std::int32_t i=0; i<nx; ++i)
+        {
+            impose(i, 0);
+            impose(i, ny-1);
+        }
+        for(std::int32_t j=1; j<ny-1; ++j)
+        {
+            impose(0,    j);
+            impose(nx-1, j);
+        }
+        return;
+    }
+
+    void restrict_to(World& parent) const
+    {
+        const double scale = (2.0 * tau_c_) / tau_f_;
+
+        for(std::int32_t cy=1; cy<region_.height-1; ++cy)
+        {
+            for(std::int32_t cx=1; cx<region_.width-1; ++cx)
+            {
+                const auto px = region_.x0 + cx;
+                const auto py = region_.y0 + cy;
+                if(parent.at(px, py).is_barrier()) {continue;}
+
+                double rho = 0;
+                Vector u{0, 0};
+                std::array<double, 9> neq{};
+                std::int32_t n = 0;
+                for(std::int32_t dj=0; dj<2; ++dj)
+                {
+                    for(std::int32_t di=0; di<2; ++di)
+                    {
+                        const auto i = 2 * cx + di;
+                        const auto j = 2 * cy + dj;
+                        const auto& g = fine_.at(i, j);
+                        if(g.is_barrier()) {continue;}
+
+                        const auto r = fine_.density_at (i, j);
+                        const auto v = fine_.velocity_at(i, j);
+                        rho = rho + r;
+                        u   = u   + v;
+                        for(std::size_t q=0; q<9; ++q)
+                        {
+                            neq[q] += g.distribution(static_cast<Direction>(q)) -
+                                      d2q9::equilibrium(q, r, v.x, v.y);
+                        }
+                        ++n;
+                    }
+                }
+                if(n == 0) {continue;}
+
+                const double inv = 1.0 / n;
+                rho *= inv;
+                u    = u * inv;
+                std::array<double, 9> f;
+                for(std::size_t q=0; q<9; ++q)
+                {
+                    f[q] = d2q9::equilibrium(q, rho, u.x, u.y) + scale * neq[q] * inv;
+                }
+                parent.assign(px, py, f);
+            }
+        }
+        return;
+    }
+
+  private:
+
+    RefinementRegion region_;
+    World  fine_;
+    double tau_c_;
+    double tau_f_;
+    ParentState old_;
+    ParentState new_;
+    std::list<RefinementPatch> children_; // stable references for refine()
+};
+
+// a World with static refinement patches
+struct RefinedWorld
+{
+  public:
+
+    explicit RefinedWorld(World coarse): coarse_(std::move(coarse)) {}
+
+    // add a patch with twice the resolution over `r` (in coarse cells)
+    RefinementPatch& refine(RefinementRegion r)
+    {
+        this->patches_.emplace_back(coarse_, r);
+        return this->patches_.back();
+    }
+
+    void step()
+    {
+        for(auto& p : patches_)
+        {
+            p.begin_step(coarse_);
+        }
+        coarse_.step();
+        for(auto& p : patches_)
+        {
+            p.end_step(coarse_);
+        }
+        return;
+    }
+
+    World const& coarse() const noexcept {return coarse_;}
+    World&       coarse()       noexcept {return coarse_;}
+    std::list<RefinementPatch> const& patches() const noexcept {return patches_;}
+
+  private:
+
+    World coarse_;
+    std::list<RefinementPatch> patches_;
+};
+
+} // lbm
+#endif // LATTICE_BOLTZMANN_REFINEMENT_HPP
@@ -0,0 +1,648 @@
+#ifndef LATTICE_BOLTZMANN_SNAPSHOT_HPP
+#define LATTICE_BOLTZMANN_SNAPSHOT_HPP
+
+// Compressed time series of the macroscopic fields.
+//
+// Each value is quantized to an integer with a per-field error bound `eps`
+// (|decoded - original| <= eps). Every `keyframe_interval`-th frame stores
+// the quantized values themselves, the others store the difference from the
+// previous frame. The integers are cut into blocks that are compressed
+// independently (zigzag + varint, with runs of zeros collapsed), so the
+// blocks of a frame are encoded in parallel.
+//
+// File layout (little endian, whatever the byte order of the host):
+//
+//   header : "LBMS" version x0 y0 width height stride nx ny
+//            keyframe_interval block_size nfields {field eps}...
+//   frames : step keyframe {nblocks {nbytes bytes}...}...  (per field)
+//   index  : {step offset}... nframes index_offset "LBMX"
+//
+// The index at the end lets SnapshotReader jump to the keyframe before the
+// requested frame, so a frame is reconstructed by decoding at most
+// `keyframe_interval` frames of a single field.
+
+#include "Fields.hpp"
+#include "World.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace lbm
+{
+
+enum class SnapshotField : std::uint8_t
+{
+    Density   = 0,
+    VelocityX = 1,
+    VelocityY = 2,
+    Vorticity = 3,
+};
+
+inline const char* to_string(const SnapshotField f) noexcept
+{
+    switch(f)
+    {
+        case SnapshotField::Density  : { return "density";    }
+        case SnapshotField::VelocityX: { return "velocity_x"; }
+        case SnapshotField::VelocityY: { return "velocity_y"; }
+        case SnapshotField::Vorticity: { return "vorticity";  }
+        default: break;
+    }
+    return "unknown";
+}
+
+struct SnapshotChannel
+{
+    SnapshotField field;
+    double        error_bound; // max. absolute error of the decoded value
+};
+
+struct SnapshotConfig
+{
+    std::vector<SnapshotChannel> channels{
+        {SnapshotField::Density,   1e-4},
+        {SnapshotField::VelocityX, 1e-4},
+        {SnapshotField::VelocityY, 1e-4},
+        {SnapshotField::Vorticity, 1e-5},
+    };
+
+    // region of interest. width, height = 0 means up to the end of the world
+    std::int32_t x0     = 0;
+    std::int32_t y0     = 0;
+    std::int32_t width  = 0;
+    std::int32_t height = 0;
+    std::int32_t stride = 1; // keep every stride-th cell in x and y
+
+    std::uint32_t keyframe_interval = 32;
+    std::uint32_t block_size        = 4096; // values per compressed block
+    std::size_t   max_pending       = 4;    // frames queued before push() waits
+};
+
+namespace snapshot_detail
+{
+inline constexpr char magic[4]       = {'L', 'B', 'M', 'S'};
+inline constexpr char index_magic[4] = {'L', 'B', 'M', 'X'};
+inline constexpr std::uint32_t version = 1;
+
+// integers and doubles are stored little endian, whatever the host byte order is
+template<typename T>
+std::uint64_t to_bits(const T v) noexcept
+{
+    static_assert(std::is_integral_v<T> || (std::is_same_v<T, double> && sizeof(double) == 8));
+    if constexpr(std::is_same_v<T, double>)
+    {
+        return std::bit_cast<std::uint64_t>(v);
+    }
+    else
+    {
+        return static_cast<std::make_unsigned_t<T>>(v);
+    }
+}
+template<typename T>
+void write(std::ostream& os, const T& v)
+{
+    const auto bits = to_bits(v);
+    char buf[sizeof(T)];
+    for(std::size_t i=0; i<sizeof(T); ++i)
+    {
+        buf[i] = static_cast<char>((bits >> (8 * i)) & 0xFF);
+    }
+    os.write(buf, sizeof(T));
+}
+
+inline void read_bytes(std::istream& is, char* buf, const std::size_t n)
+{
+    is.read(buf, static_cast<std::streamsize>(n));
+    if( ! is || static_cast<std::size_t>(is.gcount()) != n)
+    {
+        throw std::runtime_error("lbm::SnapshotReader: unexpected end of file");
+    }
+}
+template<typename T>
+T read(std::istream& is)
+{
+    unsigned char buf[sizeof(T)];
+    read_bytes(is, reinterpret_cast<char*>(buf), sizeof(T));
+
+    std::uint64_t bits = 0;
+    for(std::size_t i=0; i<sizeof(T); ++i)
+    {
+        bits |= static_cast<std::uint64_t>(buf[i]) << (8 * i);
+    }
+    if constexpr(std::is_same_v<T, double>)
+    {
+        return std::bit_cast<double>(bits);
+    }
+    else
+    {
+        return static_cast<T>(bits);
+    }
+}
+inline void seek(std::istream& is, const std::streamoff off, const std::ios::seekdir dir = std::ios::beg)
+{
+    is.seekg(off, dir);
+    if( ! is)
+    {
+        throw std::runtime_error("lbm::SnapshotReader: offset out of the file");
+    }
+}
+
+inline std::uint64_t zigzag  (const std::int64_t  v) noexcept {return (static_cast<std::uint64_t>(v) << 1) ^ static_cast<std::uint64_t>(v >> 63);}
+inline std::int64_t  unzigzag(const std::uint64_t v) noexcept {return static_cast<std::int64_t>(v >> 1) ^ -static_cast<std::int64_t>(v & 1);}
+
+inline void put_varint(std::vector<std::uint8_t>& out, std::uint64_t v)
+{
+    while(0x80 <= v)
+    {
+        out.push_back(static_cast<std::uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<std::uint8_t>(v));
+}
+inline std::uint64_t get_varint(const std::uint8_t*& p, const std::uint8_t* end)
+{
+    std::uint64_t v = 0;
+    for(std::uint32_t shift=0; p != end && shift < 64; shift += 7)
+    {
+        const auto b = *p++;
+        v |= static_cast<std::uint64_t>(b & 0x7F) << shift;
+        if((b & 0x80) == 0) {return v;}
+    }
+    throw std::runtime_error("lbm::SnapshotReader: broken block");
+}
+
+// a non-zero value is written as varint(zigzag(v)), a run of zeros as
+// varint(0) followed by varint(length - 1).
+inline void encode_block(const std::int64_t* v, const std::size_t n, std::vector<std::uint8_t>& out)
+{
+    out.clear();
+    for(std::size_t i=0; i<n; )
+    {
+        if(v[i] != 0)
+        {
+            put_varint(out, zigzag(v[i]));
+            ++i;
+            continue;
+        }
+        std::size_t run = 1;
+        while(i + run < n && v[i + run] == 0) {++run;}
+        put_varint(out, 0);
+        put_varint(out, run - 1);
+        i += run;
+    }
+    return;
+}
+inline void decode_block(const std::uint8_t* p, const std::uint8_t* end, std::int64_t* v, const std::size_t n)
+{
+    for(std::size_t i=0; i<n; )
+    {
+        const auto z = get_varint(p, end);
+        if(z != 0)
+        {
+            v[i++] = unzigzag(z);
+            continue;
+        }
+        const auto run = get_varint(p, end) + 1;
+        if(n - i < run)
+        {
+            throw std::runtime_error("lbm::SnapshotReader: broken block");
+        }
+        std::fill_n(v + i, run, 0);
+        i += run;
+    }
+    if(p != end)
+    {
+        throw std::runtime_error("lbm::SnapshotReader: broken block");
+    }
+    return;
+}
+
+// the largest size of an encoded block of n values
+inline std::size_t max_block_bytes(const std::size_t n) noexcept
+{
+    return 10 * n + 10; // a varint of 64 bits takes 10 bytes
+}
+} // snapshot_detail
+
+// Writes a snapshot series. push() samples the region of interest on the
+// calling thread; quantization and compression run on a background thread.
+struct SnapshotWriter
+{
+  public:
+
+    SnapshotWriter(const std::string& filename, const World& w, SnapshotConfig c)
+        : config_(std::move(c)), ofs_(filename, std::ios::binary), closed_(false)
+    {
+        if( ! ofs_.good())
+        {
+            throw std::runtime_error("lbm::SnapshotWriter: cannot open " + filename);
+        }
+        if(config_.width  == 0) {config_.width  = w.size_x() - config_.x0;}
+        if(config_.height == 0) {config_.height = w.size_y() - config_.y0;}
+        config_.stride            = std::max(config_.stride, 1);
+        config_.keyframe_interval = std::max<std::uint32_t>(config_.keyframe_interval, 1);
+        config_.block_size        = std::max<std::uint32_t>(config_.block_size, 1);
+        config_.max_pending       = std::max<std::size_t>(config_.max_pending, 1);
+
+        if(config_.x0 < 0 || config_.y0 < 0 || config_.width <= 0 || config_.height <= 0 ||
+           w.size_x() < config_.x0 + config_.width || w.size_y() < config_.y0 + config_.height)
+        {
+            throw std::invalid_argument("lbm::SnapshotWriter: region is out of the world");
+        }
+        for(const auto& ch : config_.channels)
+        {
+            if( ! (0 < ch.error_bound && std::isfinite(ch.error_bound)))
+            {
+                throw std::invalid_argument("lbm::SnapshotWriter: error bound must be positive and finite");
+            }
+        }
+        nx_ = (config_.width  + config_.stride - 1) / config_.stride;
+        ny_ = (config_.height + config_.stride - 1) / config_.stride;
+
+        this->write_header();
+        prev_.resize(config_.channels.size());
+        worker_ = std::thread([this] {this->run();});
+    }
+    ~SnapshotWriter()
+    {
+        this->close();
+    }
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    // sample the current state of `w`. returns after the data is copied
+    void push(const World& w)
+    {
+        Frame frame;
+        frame.step = w.steps();
+        frame.values.resize(config_.channels.size());
+
+        const bool needs_vorticity = std::any_of(config_.channels.begin(), config_.channels.end(),
+                [](const SnapshotChannel& c) {return c.field == SnapshotField::Vorticity;});
+        if(needs_vorticity)
+        {
+            fields_.compute(w);
+        }
+
+        const auto& rho = w.densities();
+        const auto& vel = w.velocities();
+        for(std::size_t c=0; c<config_.channels.size(); ++c)
+        {
+            auto& out = frame.values[c];
+            out.resize(static_cast<std::size_t>(nx_) * ny_);
+
+            const auto field = config_.channels[c].field;
+            // llround is undefined for values that do not fit an int64 (and NaN).
+            // 2^62 leaves room for the difference between two frames
+            const double limit = 0x1p62 * 2.0 * config_.channels[c].error_bound;
+            for(std::int32_t j=0; j<ny_; ++j)
+            {
+                const std::size_t row = static_cast<std::size_t>(config_.y0 + j * config_.stride) * w.size_x();
+                for(std::int32_t i=0; i<nx_; ++i)
+                {
+                    const std::size_t idx = row + config_.x0 + i * config_.stride;
+                    double v = 0;
+                    switch(field)
+                    {
+                        case SnapshotField::Density  : { v = rho[idx];   break; }
+                        case SnapshotField::VelocityX: { v = vel[idx].x; break; }
+                        case SnapshotField::VelocityY: { v = vel[idx].y; break; }
+                        case SnapshotField::Vorticity: { v = fields_.vorticity()[idx]; break; }
+                        default: break;
+                    }
+                    if( ! (std::abs(v) < limit))
+                    {
+                        throw std::domain_error(std::string("lbm::SnapshotWriter: ") + to_string(field) +
+                            " is not finite or too large at (" + std::to_string(idx % w.size_x()) +
+                            ", " + std::to_string(idx / w.size_x()) + ")");
+                    }
+                    out[static_cast<std::size_t>(j) * nx_ + i] = v;
+                }
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(mtx_);
+        if(closed_)
+        {
+            throw std::logic_error("lbm::SnapshotWriter: push() after close()");
+        }
+        cv_.wait(lock, [this] {return queue_.size() < config_.max_pending;});
+        queue_.push_back(std::move(frame));
+        cv_.notify_all();
+        return;
+    }
+
+    // encode the remaining frames and write the index
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if(closed_) {return;}
+            closed_ = true;
+        }
+        cv_.notify_all();
+        if(worker_.joinable()) {worker_.join();}
+
+        using namespace snapshot_detail;
+        const std::uint64_t index_offset = ofs_.tellp();
+        for(const auto& [step, offset] : index_)
+        {
+            write(ofs_, step);
+            write(ofs_, offset);
+        }
+        write(ofs_, static_cast<std::uint64_t>(index_.size()));
+        write(ofs_, index_offset);
+        ofs_.write(index_magic, 4);
+        ofs_.close();
+        return;
+    }
+
+    std::int32_t size_x() const noexcept {return nx_;}
+    std::int32_t size_y() const noexcept {return ny_;}
+
+  private:
+
+    struct Frame
+    {
+        std::uint64_t step;
+        std::vector<std::vector<double>> values; // [channel][cell]
+    };
+
+    void write_header()
+    {
+        using namespace snapshot_detail;
+        ofs_.write(magic, 4);
+        write(ofs_, version);
+        write(ofs_, config_.x0);
+        write(ofs_, config_.y0);
+        write(ofs_, config_.width);
+        write(ofs_, config_.height);
+        write(ofs_, config_.stride);
+        write(ofs_, nx_);
+        write(ofs_, ny_);
+        write(ofs_, config_.keyframe_interval);
+        write(ofs_, config_.block_size);
+        write(ofs_, static_cast<std::uint32_t>(config_.channels.size()));
+        for(const auto& ch : config_.channels)
+        {
+            write(ofs_, static_cast<std::uint8_t>(ch.field));
+            write(ofs_, ch.error_bound);
+        }
+        return;
+    }
+
+    void run()
+    {
+        while(true)
+        {
+            Frame frame;
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                cv_.wait(lock, [this] {return closed_ || ! queue_.empty();});
+                if(queue_.empty()) {return;} // closed and drained
+                frame = std::move(queue_.front());
+                queue_.pop_front();
+            }
+            cv_.notify_all();
+            this->encode(frame);
+        }
+    }
+
+    void encode(const Frame& frame)
+    {
+        using namespace snapshot_detail;
+
+        const bool keyframe = (index_.size() % config_.keyframe_interval == 0);
+        index_.emplace_back(frame.step, static_cast<std::uint64_t>(ofs_.tellp()));
+        write(ofs_, frame.step);
+        write(ofs_, static_cast<std::uint8_t>(keyframe));
+
+        const std::size_t n       = static_cast<std::size_t>(nx_) * ny_;
+        const std::size_t bsize   = config_.block_size;
+        const std::size_t nblocks = (n + bsize - 1) / bsize;
+
+        std::vector<std::int64_t> quantized(n);
+        std::vector<std::int64_t> delta(n);
+        std::vector<std::vector<std::uint8_t>> blocks(nblocks);
+
+        for(std::size_t c=0; c<config_.channels.size(); ++c)
+        {
+            const double inv_step = 0.5 / config_.channels[c].error_bound;
+            const auto&  values   = frame.values[c];
+            auto&        prev     = prev_[c];
+            if(prev.size() != n) {prev.assign(n, 0);}
+
+            #pragma omp parallel for schedule(static)
+            for(std::size_t b=0; b<nblocks; ++b)
+            {
+                const std::size_t first = b * bsize;
+                const std::size_t last  = std::min(n, first + bsize);
+                for(std::size_t i=first; i<last; ++i)
+                {
+                    quantized[i] = std::llround(values[i] * inv_step);
+                    delta[i]     = keyframe ? quantized[i] : quantized[i] - prev[i];
+                }
+                encode_block(delta.data() + first, last - first, blocks[b]);
+            }
+            std::swap(prev, quantized);
+
+            write(ofs_, static_cast<std::uint32_t>(nblocks));
+            for(const auto& blk : blocks)
+            {
+                write(ofs_, static_cast<std::uint32_t>(blk.size()));
+                ofs_.write(reinterpret_cast<const char*>(blk.data()), blk.size());
+            }
+        }
+        return;
+    }
+
+  private:
+
+    SnapshotConfig config_;
+    std::int32_t   nx_;
+    std::int32_t   ny_;
+    DerivedFields  fields_;
+
+    std::ofstream ofs_;
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> index_; // {step, offset}
+    std::vector<std::vector<std::int64_t>> prev_;                  // [channel][cell]
+
+    std::mutex              mtx_;
+    std::condition_variable cv_;
+    std::deque<Frame>       queue_;
+    bool                    closed_;
+    std::thread             worker_;
+};
+
+struct SnapshotReader
+{
+  public:
+
+    explicit SnapshotReader(const std::string& filename)
+        : ifs_(filename, std::ios::binary)
+    {
+        using namespace snapshot_detail;
+        if( ! ifs_.good())
+        {
+            throw std::runtime_error("lbm::SnapshotReader: cannot open " + filename);
+        }
+
+        char m[4];
+        read_bytes(ifs_, m, 4);
+        if(std::memcmp(m, magic, 4) != 0 || read<std::uint32_t>(ifs_) != version)
+        {
+            throw std::runtime_error("lbm::SnapshotReader: " + filename + " is not a snapshot file");
+        }
+        config_.x0                = read<std::int32_t >(ifs_);
+        config_.y0                = read<std::int32_t >(ifs_);
+        config_.width             = read<std::int32_t >(ifs_);
+        config_.height            = read<std::int32_t >(ifs_);
+        config_.stride            = read<std::int32_t >(ifs_);
+        nx_                       = read<std::int32_t >(ifs_);
+        ny_                       = read<std::int32_t >(ifs_);
+        config_.keyframe_interval = read<std::uint32_t>(ifs_);
+        config_.block_size        = read<std::uint32_t>(ifs_);
+
+        config_.channels.resize(read<std::uint32_t>(ifs_));
+        for(auto& ch : config_.channels)
+        {
+            ch.field       = static_cast<SnapshotField>(read<std::uint8_t>(ifs_));
+            ch.error_bound = read<double>(ifs_);
+        }
+        if(nx_ <= 0 || ny_ <= 0 || config_.keyframe_interval == 0 || config_.block_size == 0)
+        {
+            throw std::runtime_error("lbm::SnapshotReader: " + filename + " has a broken header");
+        }
+
+        constexpr std::uint64_t footer = 2 * sizeof(std::uint64_t) + 4;
+        seek(ifs_, 0, std::ios::end);
+        const std::uint64_t file_size = ifs_.tellg();
+        if(file_size < footer)
+        {
+            throw std::runtime_error("lbm::SnapshotReader: " + filename + " has no index (not closed?)");
+        }
+        seek(ifs_, -static_cast<std::streamoff>(footer), std::ios::end);
+        const auto nframes      = read<std::uint64_t>(ifs_);
+        const auto index_offset = read<std::uint64_t>(ifs_);
+        read_bytes(ifs_, m, 4);
+        if(std::memcmp(m, index_magic, 4) != 0)
+        {
+            throw std::runtime_error("lbm::SnapshotReader: " + filename + " has no index (not closed?)");
+        }
+        if(index_offset > file_size - footer || nframes != (file_size - footer - index_offset) / 16 ||
+           (file_size - footer - index_offset) % 16 != 0)
+        {
+            throw std::runtime_error("lbm::SnapshotReader: " + filename + " has a broken index");
+        }
+        seek(ifs_, static_cast<std::streamoff>(index_offset));
+        index_.resize(nframes);
+        for(auto& [step, offset] : index_)
+        {
+            step   = read<std::uint64_t>(ifs_);
+            offset = read<std::uint64_t>(ifs_);
+        }
+    }
+
+    std::size_t   frames() const noexcept {return index_.size();}
+    std::uint64_t step(std::size_t frame) const {return index_.at(frame).first;}
+
+    std::int32_t size_x() const noexcept {return nx_;}
+    std::int32_t size_y() const noexcept {return ny_;}
+    SnapshotConfig const& config() const noexcept {return config_;}
+
+    // reconstruct one field of one frame (row-major, y * size_x() + x)
+    std::vector<double> read_frame(const std::size_t frame, const SnapshotField field)
+    {
+        using namespace snapshot_detail;
+
+        const auto ch = std::find_if(config_.channels.begin(), config_.channels.end(),
+                [field](const SnapshotChannel& c) {return c.field == field;});
+        if(ch == config_.channels.end())
+        {
+            throw std::out_of_range(std::string("lbm::SnapshotReader: no field ") + to_string(field));
+        }
+        if(index_.size() <= frame)
+        {
+            throw std::out_of_range("lbm::SnapshotReader: no frame " + std::to_string(frame));
+        }
+        const std::size_t channel = std::distance(config_.channels.begin(), ch);
+        const std::size_t n       = static_cast<std::size_t>(nx_) * ny_;
+        const std::size_t nblocks = (n + config_.block_size - 1) / config_.block_size;
+
+        std::vector<std::int64_t> acc(n, 0);
+        std::vector<std::int64_t> delta(n);
+        std::vector<std::uint8_t> bytes;
+
+        const std::size_t key = frame - frame % config_.keyframe_interval;
+        for(std::size_t f=key; f<=frame; ++f)
+        {
+            seek(ifs_, static_cast<std::streamoff>(index_[f].second));
+            read<std::uint64_t>(ifs_); // step
+            const bool keyframe = read<std::uint8_t>(ifs_) != 0;
+
+            for(std::size_t c=0; c<config_.channels.size(); ++c)
+            {
+                if(read<std::uint32_t>(ifs_) != nblocks)
+                {
+                    throw std::runtime_error("lbm::SnapshotReader: broken frame " + std::to_string(f));
+                }
+                for(std::uint32_t b=0; b<nblocks; ++b)
+                {
+                    const std::size_t first = static_cast<std::size_t>(b) * config_.block_size;
+                    const std::size_t last  = std::min<std::size_t>(n, first + config_.block_size);
+
+                    const auto nbytes = read<std::uint32_t>(ifs_);
+                    if(max_block_bytes(last - first) < nbytes)
+                    {
+                        throw std::runtime_error("lbm::SnapshotReader: broken block");
+                    }
+                    if(c != channel)
+                    {
+                        seek(ifs_, nbytes, std::ios::cur);
+                        continue;
+                    }
+                    bytes.resize(nbytes);
+                    read_bytes(ifs_, reinterpret_cast<char*>(bytes.data()), nbytes);
+                    decode_block(bytes.data(), bytes.data() + bytes.size(), delta.data() + first, last - first);
+                }
+                if(c == channel) {break;}
+            }
+            for(std::size_t i=0; i<n; ++i)
+            {
+                acc[i] = keyframe ? delta[i] : acc[i] + delta[i];
+            }
+        }
+
+        const double step = 2.0 * ch->error_bound;
+        std::vector<double> values(n);
+        for(std::size_t i=0; i<n; ++i)
+        {
+            values[i] = static_cast<double>(acc[i]) * step;
+        }
+        return values;
+    }
+
+  private:
+
+    std::ifstream  ifs_;
+    SnapshotConfig config_;
+    std::int32_t   nx_;
+    std::int32_t   ny_;
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> index_; // {step, offset}
+};
+
+} // lbm
+#endif // LATTICE_BOLTZMANN_SNAPSHOT_HPP
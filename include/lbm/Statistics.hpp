@@ -0,0 +1,196 @@
+#ifndef LATTICE_BOLTZMANN_STATISTICS_HPP
+#define LATTICE_BOLTZMANN_STATISTICS_HPP
+
+#include "Vector.hpp"
+
+#include <algorithm>
+#include <ostream>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+
+namespace lbm
+{
+
+struct StatisticsConfig
+{
+    std::size_t start    = 0; // first step that is sampled
+    std::size_t interval = 1; // sample once per `interval` steps
+    std::size_t window   = 0; // samples per averaging window. 0 means unbounded
+};
+
+// time-averaged fields, finalized from RunningStatistics
+struct FlowStatistics
+{
+    std::int32_t nx;
+    std::int32_t ny;
+    std::size_t  samples;
+    std::size_t  first_step;
+    std::size_t  last_step;
+
+    // row-major, y * nx + x
+    std::vector<double> mean_density;
+    std::vector<double> mean_u;
+    std::vector<double> mean_v;
+    std::vector<double> rms_u;            // sqrt(<u'u'>)
+    std::vector<double> rms_v;            // sqrt(<v'v'>)
+    std::vector<double> reynolds_stress;  // <u'v'>
+
+    // one line per cell: x y rho u v u_rms v_rms u'v'
+    void write(std::ostream& os) const
+    {
+        os << "# samples " << samples << " steps " << first_step << " - " << last_step << '\n';
+        os << "# x y rho u v u_rms v_rms uv\n";
+        for(std::int32_t y=0; y<ny; ++y)
+        {
+            for(std::int32_t x=0; x<nx; ++x)
+            {
+                const std::size_t i = static_cast<std::size_t>(y) * nx + x;
+                os << x << ' ' << y << ' ' << mean_density[i] << ' '
+                   << mean_u[i] << ' ' << mean_v[i] << ' '
+                   << rms_u[i]  << ' ' << rms_v[i]  << ' ' << reynolds_stress[i] << '\n';
+            }
+        }
+        return;
+    }
+};
+
+// Streaming (Welford) accumulators for the mean and the second moments of
+// the velocity fluctuation. World feeds one sample per cell from the loop
+// that updates rho and u, so no field ever has to be stored per step.
+//
+// All cells are sampled together; a sample is bracketed by begin_sample()
+// and end_sample() and accumulate() may be called for different cells from
+// different threads in between.
+struct RunningStatistics
+{
+  public:
+
+    RunningStatistics(std::int32_t nx, std::int32_t ny, StatisticsConfig c)
+        : nx_(nx), ny_(ny), config_(c), count_(0), inv_n_(0),
+          first_step_(0), last_step_(0)
+    {
+        config_.interval = std::max<std::size_t>(config_.interval, 1);
+
+        const std::size_t n = static_cast<std::size_t>(nx) * ny;
+        rho_.resize(n);
+        mu_ .resize(n);
+        mv_ .resize(n);
+        muu_.resize(n);
+        mvv_.resize(n);
+        muv_.resize(n);
+        this->reset();
+    }
+
+    bool should_sample(const std::size_t step) const noexcept
+    {
+        return config_.start <= step && (step - config_.start) % config_.interval == 0;
+    }
+
+    void begin_sample(const std::size_t step) noexcept
+    {
+        if(count_ == 0) {first_step_ = step;}
+        last_step_ = step;
+        inv_n_ = 1.0 / static_cast<double>(count_ + 1);
+    }
+
+    void accumulate(const std::size_t i, const double rho, const Vector u) noexcept
+    {
+        const double du = u.x - mu_[i];
+        const double dv = u.y - mv_[i];
+        rho_[i] += (rho - rho_[i]) * inv_n_;
+        mu_ [i] += du * inv_n_;
+        mv_ [i] += dv * inv_n_;
+        muu_[i] += du * (u.x - mu_[i]);
+        mvv_[i] += dv * (u.y - mv_[i]);
+        muv_[i] += du * (u.y - mv_[i]);
+    }
+
+    void end_sample()
+    {
+        ++count_;
+        if(config_.window != 0 && config_.window <= count_)
+        {
+            this->windows_.push_back(this->result());
+            this->reset();
+        }
+        return;
+    }
+
+    // statistics of the samples taken since the last completed window
+    FlowStatistics result() const
+    {
+        const std::size_t n = rho_.size();
+
+        FlowStatistics s;
+        s.nx         = nx_;
+        s.ny         = ny_;
+        s.samples    = count_;
+        s.first_step = first_step_;
+        s.last_step  = last_step_;
+        s.mean_density    = rho_;
+        s.mean_u          = mu_;
+        s.mean_v          = mv_;
+        s.rms_u          .resize(n);
+        s.rms_v          .resize(n);
+        s.reynolds_stress.resize(n);
+
+        const double inv = (count_ == 0) ? 0.0 : 1.0 / static_cast<double>(count_);
+        for(std::size_t i=0; i<n; ++i)
+        {
+            s.rms_u[i]           = std::sqrt(muu_[i] * inv);
+            s.rms_v[i]           = std::sqrt(mvv_[i] * inv);
+            s.reynolds_stress[i] = muv_[i] * inv;
+        }
+        return s;
+    }
+
+    // the windows that reached `config.window` samples, oldest first. they are
+    // kept until take_windows() is called, e.g. at a checkpoint
+    std::vector<FlowStatistics> const& windows() const noexcept {return windows_;}
+    std::vector<FlowStatistics> take_windows()
+    {
+        std::vector<FlowStatistics> w;
+        std::swap(w, this->windows_);
+        return w;
+    }
+
+    std::size_t samples() const noexcept {return count_;}
+    StatisticsConfig const& config() const noexcept {return config_;}
+
+  private:
+
+    void reset()
+    {
+        count_ = 0;
+        std::fill(rho_.begin(), rho_.end(), 0.0);
+        std::fill(mu_ .begin(), mu_ .end(), 0.0);
+        std::fill(mv_ .begin(), mv_ .end(), 0.0);
+        std::fill(muu_.begin(), muu_.end(), 0.0);
+        std::fill(mvv_.begin(), mvv_.end(), 0.0);
+        std::fill(muv_.begin(), muv_.end(), 0.0);
+        return;
+    }
+
+  private:
+
+    std::int32_t nx_;
+    std::int32_t ny_;
+    StatisticsConfig config_;
+    std::size_t count_;
+    double      inv_n_;
+    std::size_t first_step_;
+    std::size_t last_step_;
+
+    std::vector<double> rho_; // mean density
+    std::vector<double> mu_;  // mean velocity
+    std::vector<double> mv_;
+    std::vector<double> muu_; // sums of squared deviations
+    std::vector<double> mvv_;
+    std::vector<double> muv_;
+
+    std::vector<FlowStatistics> windows_; // completed, not yet taken
+};
+
+} // lbm
+#endif // LATTICE_BOLTZMANN_STATISTICS_HPP
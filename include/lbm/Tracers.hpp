@@ -0,0 +1,250 @@
+#ifndef LATTICE_BOLTZMANN_TRACERS_HPP
+#define LATTICE_BOLTZMANN_TRACERS_HPP
+
+#include "World.hpp"
+#include "Vector.hpp"
+
+#include <algorithm>
+#include <ostream>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+
+namespace lbm
+{
+
+// Massless particles advected by the velocity of a World.
+//
+// Positions are in cell units; the cell (x, y) is centered at (x, y). The
+// velocity is bilinearly interpolated between the 4 surrounding cells and
+// integrated with the midpoint rule. Positions are stored as separate x and
+// y arrays and updated in parallel. Every `sort_interval` advections the
+// particles are reordered by cell so that neighboring particles read
+// neighboring velocities.
+//
+// A particle that leaves the lattice or enters a Barrier is put back at a
+// random inlet: a ConstantFlow cell whose velocity points into a fluid cell.
+struct Tracers
+{
+  public:
+
+    explicit Tracers(const World& w, std::size_t sort_interval = 64, std::uint64_t seed = 0)
+        : nx_(w.size_x()), ny_(w.size_y()), sort_interval_(sort_interval),
+          seed_(seed), advected_(0), blocked_(w.size_x() * w.size_y(), 0)
+    {
+        for(std::int32_t y=0; y<ny_; ++y)
+        {
+            for(std::int32_t x=0; x<nx_; ++x)
+            {
+                const auto& g = w.at(x, y);
+                if(g.is_barrier())
+                {
+                    blocked_[idx_of(x, y)] = 1;
+                }
+                if( ! g.is_boundary()) {continue;}
+
+                const auto u  = w.velocity_at(x, y);
+                const auto dx = (u.x > 0) - (u.x < 0);
+                const auto dy = (u.y > 0) - (u.y < 0);
+                const auto to_x = x + dx;
+                const auto to_y = y + dy;
+                if((dx != 0 || dy != 0) && 0 <= to_x && to_x < nx_ && 0 <= to_y && to_y < ny_ &&
+                   w.at(to_x, to_y).is_cell())
+                {
+                    inlets_.push_back(idx_of(x, y));
+                }
+            }
+        }
+    }
+
+    void add(const double x, const double y)
+    {
+        x_.push_back(x);
+        y_.push_back(y);
+    }
+
+    // put n particles at random inlets
+    void seed(const std::size_t n)
+    {
+        const auto first = x_.size();
+        x_.resize(first + n);
+        y_.resize(first + n);
+
+        #pragma omp parallel for schedule(static)
+        for(std::size_t i=first; i<first+n; ++i)
+        {
+            this->reseed(i);
+        }
+        return;
+    }
+
+    void advect(const World& w, const double dt = 1.0)
+    {
+        const Vector* vel = w.velocities().data();
+        const std::size_t n = x_.size();
+        double* px = x_.data();
+        double* py = y_.data();
+
+        #pragma omp parallel for schedule(static)
+        for(std::size_t i=0; i<n; ++i)
+        {
+            const Vector v1 = interpolate(vel, px[i], py[i]);
+            const Vector v2 = interpolate(vel, px[i] + 0.5 * dt * v1.x, py[i] + 0.5 * dt * v1.y);
+            px[i] += dt * v2.x;
+            py[i] += dt * v2.y;
+
+            if( ! this->is_open(px[i], py[i]))
+            {
+                this->reseed(i);
+            }
+        }
+
+        ++advected_;
+        if(sort_interval_ != 0 && advected_ % sort_interval_ == 0)
+        {
+            this->sort();
+        }
+        return;
+    }
+
+    // reorder the particles by the cell they are in (counting sort)
+    void sort()
+    {
+        const std::size_t n = x_.size();
+        std::vector<std::size_t> offsets(blocked_.size() + 1, 0);
+        std::vector<std::size_t> cell(n);
+        for(std::size_t i=0; i<n; ++i)
+        {
+            cell[i] = cell_of(x_[i], y_[i]);
+            offsets[cell[i] + 1] += 1;
+        }
+        for(std::size_t c=1; c<offsets.size(); ++c)
+        {
+            offsets[c] += offsets[c-1];
+        }
+
+        sorted_x_.resize(n);
+        sorted_y_.resize(n);
+        for(std::size_t i=0; i<n; ++i)
+        {
+            const auto j = offsets[cell[i]]++;
+            sorted_x_[j] = x_[i];
+            sorted_y_[j] = y_[i];
+        }
+        std::swap(x_, sorted_x_);
+        std::swap(y_, sorted_y_);
+        return;
+    }
+
+    // n, then n pairs of (x, y) as float32. 8 bytes per particle
+    void write(std::ostream& os) const
+    {
+        const std::uint64_t n = x_.size();
+        os.write(reinterpret_cast<const char*>(&n), sizeof(n));
+
+        std::vector<float> buf(2 * x_.size());
+        for(std::size_t i=0; i<x_.size(); ++i)
+        {
+            buf[2*i  ] = static_cast<float>(x_[i]);
+            buf[2*i+1] = static_cast<float>(y_[i]);
+        }
+        os.write(reinterpret_cast<const char*>(buf.data()), buf.size() * sizeof(float));
+        return;
+    }
+
+    std::size_t size() const noexcept {return x_.size();}
+    std::vector<double> const& x() const noexcept {return x_;}
+    std::vector<double> const& y() const noexcept {return y_;}
+
+    std::size_t inlets() const noexcept {return inlets_.size();}
+
+  private:
+
+    std::size_t idx_of(std::int32_t x, std::int32_t y) const noexcept
+    {
+        return static_cast<std::size_t>(y) * nx_ + x;
+    }
+    std::size_t cell_of(const double x, const double y) const noexcept
+    {
+        // truncation rounds to nearest for x >= -0.5; the rest is clamped anyway
+        const auto cx = std::clamp<std::int32_t>(static_cast<std::int32_t>(x + 0.5), 0, nx_ - 1);
+        const auto cy = std::clamp<std::int32_t>(static_cast<std::int32_t>(y + 0.5), 0, ny_ - 1);
+        return idx_of(cx, cy);
+    }
+    bool is_open(const double x, const double y) const noexcept
+    {
+        if( ! (-0.5 <= x && x < nx_ - 0.5 && -0.5 <= y && y < ny_ - 0.5)) {return false;}
+        return blocked_[cell_of(x, y)] == 0;
+    }
+
+    Vector interpolate(const Vector* vel, const double x, const double y) const noexcept
+    {
+        const double cx = std::clamp(x, 0.0, nx_ - 1.0);
+        const double cy = std::clamp(y, 0.0, ny_ - 1.0);
+        const auto   ix = std::min<std::int32_t>(static_cast<std::int32_t>(cx), nx_ - 2);
+        const auto   iy = std::min<std::int32_t>(static_cast<std::int32_t>(cy), ny_ - 2);
+        const double fx = cx - ix;
+        const double fy = cy - iy;
+
+        const Vector* v0 = vel + idx_of(ix, iy); // (ix, iy), (ix+1, iy)
+        const Vector* v1 = v0 + nx_;             // (ix, iy+1), (ix+1, iy+1)
+        const double w00 = (1 - fx) * (1 - fy);
+        const double w10 =      fx  * (1 - fy);
+        const double w01 = (1 - fx) *      fy ;
+        const double w11 =      fx  *      fy ;
+        return Vector{
+            w00 * v0[0].x + w10 * v0[1].x + w01 * v1[0].x + w11 * v1[1].x,
+            w00 * v0[0].y + w10 * v0[1].y + w01 * v1[0].y + w11 * v1[1].y
+        };
+    }
+
+    // splitmix64. stateless, so that it can be called from any thread
+    static std::uint64_t hash(std::uint64_t z) noexcept
+    {
+        z += 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+    static double uniform(const std::uint64_t h) noexcept // [0, 1)
+    {
+        return static_cast<double>(h >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    void reseed(const std::size_t i) noexcept
+    {
+        if(inlets_.empty())
+        {
+            x_[i] = std::clamp(x_[i], 0.0, nx_ - 1.0);
+            y_[i] = std::clamp(y_[i], 0.0, ny_ - 1.0);
+            return;
+        }
+        const auto h0 = hash(seed_ ^ hash(advected_ ^ hash(i)));
+        const auto h1 = hash(h0);
+        const auto h2 = hash(h1);
+
+        const auto c = inlets_[h0 % inlets_.size()];
+        x_[i] = static_cast<double>(c % nx_) + uniform(h1) - 0.5;
+        y_[i] = static_cast<double>(c / nx_) + uniform(h2) - 0.5;
+        return;
+    }
+
+  private:
+
+    std::int32_t nx_;
+    std::int32_t ny_;
+    std::size_t   sort_interval_;
+    std::uint64_t seed_;
+    std::uint64_t advected_;
+
+    std::vector<double> x_;
+    std::vector<double> y_;
+    std::vector<double> sorted_x_; // scratch for sort()
+    std::vector<double> sorted_y_;
+
+    std::vector<std::uint8_t> blocked_; // Barrier cells
+    std::vector<std::size_t>  inlets_;
+};
+
+} // lbm
+#endif // LATTICE_BOLTZMANN_TRACERS_HPP
@@ -3,11 +3,15 @@
 
 #include "SDLResource.hpp"
 #include "World.hpp"
+#include "Fields.hpp"
+#include "Profiler.hpp"
+#include "Tracers.hpp"
 
 #include <algorithm>
 #include <memory>
 #include <stdexcept>
 #include <fstream>
+#include <vector>
 
 namespace lbm
 {
@@ -18,7 +22,7 @@ struct Window
 
     Window(std::size_t w, std::size_t h, std::size_t c)
         : finish_(false), cell_size_(c),
-          sdl_resource_{},
+          sdl_resource_{}, fields_{}, points_{},
           window_(nullptr, &SDL_DestroyWindow),
           renderer_(nullptr, &SDL_DestroyRenderer)
     {
@@ -49,7 +53,8 @@ struct Window
     Window& operator=(const Window&) = delete;
     Window& operator=(Window&&)      = default;
 
-    void update(const World& w)
+    // draw the vorticity of `w` and, if given, the tracer particles on top
+    void update(const World& w, const Tracers* tracers = nullptr)
     {
         SDL_Event event;
         while (SDL_PollEvent(&event))
@@ -69,9 +74,14 @@ struct Window
             return;
         }
 
+        LBM_PROFILE_SCOPE("render");
+
         SDL_SetRenderDrawColor(renderer_.get(), 0x80, 0x80, 0x80, 0xFF);
         SDL_RenderClear(renderer_.get());
 
+        fields_.compute(w);
+        const auto& vort = fields_.vorticity();
+
         for(std::int32_t y=0; y<w.size_y(); ++y)
         {
             for(std::int32_t x=0; x<w.size_x(); ++x)
@@ -89,13 +99,26 @@ struct Window
                 }
                 else
                 {
-                    const auto scale = w.rot_z(x, y) * 40;
+                    const auto scale = vort[y * w.size_x() + x] * 40;
                     const auto [r, g, b] = colormap(scale);
                     SDL_SetRenderDrawColor(renderer_.get(), r, g, b, 0xFF);
                 }
                 SDL_RenderFillRect(renderer_.get(), std::addressof(cell));
             }
         }
+        if(tracers != nullptr)
+        {
+            const auto& tx = tracers->x();
+            const auto& ty = tracers->y();
+            points_.resize(tracers->size());
+            for(std::size_t i=0; i<points_.size(); ++i)
+            {
+                points_[i].x = static_cast<int>((tx[i] + 0.5) * cell_size_);
+                points_[i].y = static_cast<int>((ty[i] + 0.5) * cell_size_);
+            }
+            SDL_SetRenderDrawColor(renderer_.get(), 0x20, 0x20, 0x20, 0xFF);
+            SDL_RenderDrawPoints(renderer_.get(), points_.data(), static_cast<int>(points_.size()));
+        }
         SDL_RenderPresent(renderer_.get());
         return ;
     }
@@ -122,6 +145,9 @@ struct Window
 
     void dump(std::string filename, const World& w)
     {
+        fields_.compute(w);
+        const auto& vort = fields_.vorticity();
+
         std::ofstream ofs(filename);
         ofs << std::format("P3\n{} {}\n255\n", w.size_x(), w.size_y());
         for(std::int32_t y=0; y<w.size_y(); ++y)
@@ -134,7 +160,7 @@ struct Window
                 }
                 else
                 {
-                    const auto scale = w.rot_z(x, y) * 40;
+                    const auto scale = vort[y * w.size_x() + x] * 40;
                     const auto [r, g, b] = colormap(scale);
                     ofs << std::format("{} {} {}\n", r, g, b);
                 }
@@ -147,6 +173,8 @@ struct Window
     bool finish_;
     std::int32_t cell_size_;
     SDLResource sdl_resource_;
+    DerivedFields fields_;
+    std::vector<SDL_Point> points_;
     std::unique_ptr<SDL_Window,   decltype(&SDL_DestroyWindow)>   window_;
     std::unique_ptr<SDL_Renderer, decltype(&SDL_DestroyRenderer)> renderer_;
 };
@@ -2,23 +2,54 @@
 #define LATTICE_BOLTZMANN_WORLD_HPP
 
 #include "BGK.hpp"
+#include "Boundary.hpp"
+#include "Convergence.hpp"
+#include "Geometry.hpp"
 #include "Grid.hpp"
+#include "PassiveScalar.hpp"
+#include "Profiler.hpp"
+#include "Statistics.hpp"
 #include "Vector.hpp"
 
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
 #include <vector>
 #include <optional>
 #include <cstdint>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 namespace lbm
 {
 
+enum class StepKernel : std::uint8_t
+{
+    Split, // collide the whole lattice, then stream it
+    Fused, // collide and stream tile by tile
+};
+
+// how World::step traverses the lattice
+struct StepConfig
+{
+    StepKernel   kernel  = StepKernel::Split;
+    std::int32_t tile_x  = 0; // tile size in cells. 0 means no tiling in x
+    std::int32_t tile_y  = 0; // 0 means no tiling in y
+    std::int32_t threads = 0; // 0 means the OpenMP default
+};
+
 struct World
 {
    public:
 
     World(std::int32_t nx, std::int32_t ny, BGK bgk)
         : nx_(nx), ny_(ny), grids_(nx*ny), buffer_(nx*ny),
-          density_(nx*ny), velocity_(nx*ny), bgk_(bgk)
+          density_(nx*ny), velocity_(nx*ny), bgk_(bgk), step_(0), config_{},
+          sites_dirty_(true)
     {}
 
     template<typename T>
@@ -26,8 +57,31 @@ struct World
     {
         const auto idx = idx_of(x,y);
         assert(idx.has_value());
+        if constexpr(std::is_same_v<T, ConstantFlow>)
+        {
+            this->check_condition(g.condition());
+            this->check_outflow(x, y, g.condition());
+        }
         this->buffer_.at(idx.value()) = g;
         this->grids_ .at(idx.value()) = g;
+        this->sites_dirty_ = true;
+    }
+
+    // register a boundary condition. ConstantFlow cells refer to it by the
+    // returned index, e.g. set_grid(x, y, ConstantFlow(world.add_boundary(bc)))
+    std::uint32_t add_boundary(BoundaryCondition bc)
+    {
+        this->conditions_.push_back(bc);
+        return static_cast<std::uint32_t>(this->conditions_.size() - 1);
+    }
+    // changing a condition affects all the cells that refer to it. the cells
+    // are checked again on the next step, in case it became an outflow
+    BoundaryCondition const& boundary(std::uint32_t i) const {return conditions_.at(i);}
+    BoundaryCondition&       boundary(std::uint32_t i)
+    {
+        auto& bc = conditions_.at(i);
+        this->sites_dirty_ = true;
+        return bc;
     }
 
     void initialize(std::int32_t x, std::int32_t y, double rho, Vector u)
@@ -39,73 +93,277 @@ struct World
         this->grids_   .at(idx.value()).initialize(this->bgk_, rho, u);
     }
 
+    // set up every cell at once: the kind from `g` and the equilibrium of
+    // (rho, u), in one parallel pass. Barrier cells get rho = 0, u = 0, as
+    // step() would give them. the ConstantFlow cells refer to the boundary
+    // condition `condition`
+    void load(const Geometry& g, double rho, Vector u, std::uint32_t condition)
+    {
+        assert(g.size_x() == nx_ && g.size_y() == ny_);
+        this->check_condition(condition);
+        for(std::int32_t y=0; y<ny_; ++y)
+        {
+            for(std::int32_t x=0; x<nx_; ++x)
+            {
+                if(g.at(x, y) == CellKind::Boundary)
+                {
+                    this->check_outflow(x, y, condition);
+                }
+            }
+        }
+
+        Cell cell;
+        cell.initialize(this->bgk_, rho, u);
+        ConstantFlow boundary(condition);
+        boundary.initialize(this->bgk_, rho, u);
+        const Grid fluid_grid(cell);
+        const Grid barrier_grid{Barrier()};
+        const Grid boundary_grid(boundary);
+
+        const CellKind* kinds = g.cells().data();
+        const std::size_t n = grids_.size();
+
+        #pragma omp parallel for schedule(static)
+        for(std::size_t i=0; i<n; ++i)
+        {
+            const bool barrier = (kinds[i] == CellKind::Barrier);
+            const Grid& src = barrier ? barrier_grid :
+                              (kinds[i] == CellKind::Boundary) ? boundary_grid : fluid_grid;
+            this->grids_   [i] = src;
+            this->buffer_  [i] = src;
+            this->density_ [i] = barrier ? 0.0 : rho;
+            this->velocity_[i] = barrier ? Vector{0, 0} : u;
+        }
+        this->sites_dirty_ = true;
+    }
+    // the ConstantFlow cells keep (rho, u)
+    void load(const Geometry& g, double rho, Vector u)
+    {
+        this->load(g, rho, u, this->add_boundary(BoundaryCondition::equilibrium(rho, u)));
+    }
+
+    // overwrite the populations of a cell and recompute its rho and u
+    void assign(std::int32_t x, std::int32_t y, const std::array<double, 9>& f)
+    {
+        const auto idx = idx_of(x,y);
+        assert(idx.has_value());
+        auto& grid = this->grids_.at(idx.value());
+        for(const auto dir : all_dirs)
+        {
+            grid.set_distribution(dir, f[static_cast<std::size_t>(dir)]);
+        }
+        const auto rho = grid.density();
+        this->density_ .at(idx.value()) = rho;
+        this->velocity_.at(idx.value()) = grid.velocity(rho);
+    }
+
     void step()
     {
-        // collide
-        for(std::size_t i=0; i<grids_.size(); ++i)
+        LBM_PROFILE_SCOPE("step");
+
+        // the kinds of cells changed since the last step
+        if(sites_dirty_)
         {
-            bgk_.collide(this->grids_.at(i),
-                    this->density_.at(i), this->velocity_.at(i));
+            this->find_sites();
+            this->sync_scalar_walls();
         }
 
-        // stream
-        for(std::int32_t y=0; y<ny_; ++y)
+        // rough estimates of the memory traffic of each phase
+        [[maybe_unused]] const std::uint64_t n_bytes_grid  = grids_.size() * sizeof(Grid);
+        [[maybe_unused]] const std::uint64_t n_bytes_macro = grids_.size() * (sizeof(double) + sizeof(Vector));
+
+        [[maybe_unused]] const int nthreads = this->num_threads();
+
+        if(config_.kernel == StepKernel::Split)
         {
-            for(std::int32_t x=0; x<nx_; ++x)
+            // collide
             {
-                auto& grid = this->grids_.at(idx_of(x, y).value());
+                LBM_PROFILE_SCOPE_BYTES("collide", 2 * n_bytes_grid + n_bytes_macro);
 
-                for(const auto dir : all_dirs)
+                #pragma omp parallel num_threads(nthreads)
                 {
-                    const auto [dx, dy] = offset(dir);
-                    if(const auto idx = idx_of(x+dx, y+dy))
+                    LBM_PROFILE_SCOPE("collide (thread)");
+
+                    #pragma omp for schedule(static) nowait
+                    for(std::size_t i=0; i<grids_.size(); ++i)
                     {
-                        this->buffer_.at(idx.value()).set_distribution(
-                                dir, grid.distribution(dir));
+                        bgk_.collide(this->grids_[i], this->density_[i], this->velocity_[i]);
                     }
                 }
             }
+
+            // stream
+            {
+                LBM_PROFILE_SCOPE_BYTES("stream", 2 * n_bytes_grid);
+                this->for_each_tile([this](std::int32_t x0, std::int32_t y0, std::int32_t x1, std::int32_t y1) {
+                    this->stream_tile(x0, y0, x1, y1);
+                });
+            }
+        }
+        else // StepKernel::Fused
+        {
+            // collide and stream a tile at once, while it is in cache
+            LBM_PROFILE_SCOPE_BYTES("collide + stream", 2 * n_bytes_grid + n_bytes_macro);
+            this->for_each_tile([this](std::int32_t x0, std::int32_t y0, std::int32_t x1, std::int32_t y1) {
+                for(std::int32_t y=y0; y<y1; ++y)
+                {
+                    for(std::int32_t x=x0; x<x1; ++x)
+                    {
+                        const std::size_t i = static_cast<std::size_t>(y) * nx_ + x;
+                        bgk_.collide(this->grids_[i], this->density_[i], this->velocity_[i]);
+                    }
+                }
+                this->stream_tile(x0, y0, x1, y1);
+            });
+        }
+        if(scalar_)
+        {
+            scalar_->swap();
         }
 
         // bounce back
-        for(std::int32_t y=0; y<ny_; ++y)
         {
-            for(std::int32_t x=0; x<nx_; ++x)
+            LBM_PROFILE_SCOPE_BYTES("bounce back", n_bytes_grid);
+            this->for_each_tile([this](std::int32_t x0, std::int32_t y0, std::int32_t x1, std::int32_t y1) {
+                this->bounce_back_tile(x0, y0, x1, y1);
+            });
+        }
+
+        std::swap(this->buffer_, this->grids_);
+
+        const bool check = monitor_.has_value() && monitor_->should_check(step_);
+
+        // rebuild the populations of the ConstantFlow cells and set their rho, u.
+        // the change of their rho, u is added to the residual here
+        ResidualSums boundary_sums;
+        {
+            LBM_PROFILE_SCOPE("boundaries");
+            boundary_sums = this->apply_boundaries(check);
+        }
+
+        // update rho, u. the residual and the statistics are updated in the same loop
+        {
+            LBM_PROFILE_SCOPE_BYTES("moments", n_bytes_grid + 2 * n_bytes_macro);
+
+            const bool sample = stats_  .has_value() && stats_  ->should_sample(step_);
+            const bool has_scalar = scalar_.has_value();
+            if(sample)
             {
-                auto& grid = this->buffer_.at(idx_of(x, y).value());
-                if( ! grid.bounces()) {continue;}
+                stats_->begin_sample(step_);
+            }
 
-                for(const auto dir : all_dirs)
-                {
-                    const auto [back, d] = grid.bounce_back(dir);
-                    const auto [dx, dy] = offset(back);
+            double du2      = boundary_sums.du2;
+            double du_max   = boundary_sums.du_max;
+            double drho2    = boundary_sums.drho2;
+            double drho_max = boundary_sums.drho_max;
+            double u2 = 0, rho2 = 0;
 
-                    if(const auto back_idx = idx_of(x+dx, y+dy))
+            #pragma omp parallel num_threads(nthreads) \
+                reduction(+:du2,u2,drho2,rho2) reduction(max:du_max,drho_max)
+            {
+                LBM_PROFILE_SCOPE("moments (thread)");
+
+                #pragma omp for schedule(static) nowait
+                for(std::size_t i=0; i<grids_.size(); ++i)
+                {
+                    // boundary cells already have the rho, u of their condition,
+                    // and their change is in boundary_sums. Barrier cells have
+                    // no fluid and stay out of the residual
+                    const bool boundary = grids_[i].is_boundary();
+                    const auto rho = boundary ? density_ [i] : grids_[i].density();
+                    const auto u   = boundary ? velocity_[i] : grids_[i].velocity(rho);
+                    if(check && ! grids_[i].is_barrier())
+                    {
+                        const auto du   = length_sq(u - velocity_[i]);
+                        const auto drho = std::abs(rho - density_[i]);
+                        du2   += du;
+                        u2    += length_sq(u);
+                        drho2 += drho * drho;
+                        rho2  += rho * rho;
+                        du_max   = std::max(du_max,   du);
+                        drho_max = std::max(drho_max, drho);
+                    }
+                    if(sample)
+                    {
+                        stats_->accumulate(i, rho, u);
+                    }
+                    if(has_scalar)
                     {
-                        this->buffer_.at(back_idx.value()).set_distribution(back, d);
+                        scalar_->collide(i, u);
                     }
+                    density_ [i] = rho;
+                    velocity_[i] = u;
                 }
             }
+            if(check)
+            {
+                monitor_->record(step_, ResidualSums{du2, u2, du_max, drho2, rho2, drho_max});
+                LBM_PROFILE_COUNT("velocity residual", monitor_->last()->velocity_l2);
+            }
+            if(sample)
+            {
+                stats_->end_sample();
+            }
         }
+        ++step_;
+        return;
+    }
 
-        std::swap(this->buffer_, this->grids_);
+    // check the change of rho and u every `c.interval` steps
+    void monitor_convergence(ConvergenceCriteria c)
+    {
+        this->monitor_.emplace(c);
+    }
 
-        // update grid, rho, u
-        for(std::size_t i=0; i<grids_.size(); ++i)
+    // true once the last check satisfied all thresholds
+    bool converged() const noexcept
+    {
+        return monitor_.has_value() && monitor_->converged();
+    }
+    std::optional<Residual> residual() const
+    {
+        if( ! monitor_.has_value()) {return std::nullopt;}
+        return monitor_->last();
+    }
+
+    // accumulate time-averaged rho, u and the velocity fluctuations
+    void collect_statistics(StatisticsConfig c)
+    {
+        this->stats_.emplace(nx_, ny_, c);
+    }
+    std::optional<RunningStatistics> const& statistics() const noexcept {return stats_;}
+    std::optional<RunningStatistics>&       statistics()       noexcept {return stats_;}
+
+    // transport a passive scalar with the flow. Barrier cells become walls,
+    // also those placed later by set_grid() or load(). the walls already in
+    // `s` are kept
+    void attach_scalar(PassiveScalar s)
+    {
+        if(s.size_x() != nx_ || s.size_y() != ny_)
         {
-            const auto rho = grids_.at(i).density();
-            density_ .at(i) = rho;
-            velocity_.at(i) = grids_.at(i).velocity(rho);
+            throw std::invalid_argument("lbm::World::attach_scalar: the scalar has a different shape");
         }
-        return;
+        this->scalar_.emplace(std::move(s));
+        this->scalar_barriers_.assign(grids_.size(), ScalarBarrier::None);
+        this->sync_scalar_walls();
     }
+    std::optional<PassiveScalar> const& scalar() const noexcept {return scalar_;}
+    std::optional<PassiveScalar>&       scalar()       noexcept {return scalar_;}
 
+    std::size_t steps() const noexcept {return step_;}
+    BGK const&  model() const noexcept {return bgk_;}
+
+    // read-only: change cells with set_grid(), initialize() or assign(), so
+    // that World knows about the new kinds before the next step
     Grid const& at(std::int32_t x, std::int32_t y) const { return grids_.at(idx_of(x,y).value()); }
-    Grid&       at(std::int32_t x, std::int32_t y)       { return grids_.at(idx_of(x,y).value()); }
 
     double density_at (std::int32_t x, std::int32_t y) const { return density_ .at(idx_of(x,y).value()); }
     Vector velocity_at(std::int32_t x, std::int32_t y) const { return velocity_.at(idx_of(x,y).value()); }
 
+    // row-major (y * size_x() + x) views for bulk consumers like DerivedFields
+    std::vector<double> const& densities () const noexcept {return density_;}
+    std::vector<Vector> const& velocities() const noexcept {return velocity_;}
+
     std::int32_t size_x() const noexcept {return nx_;}
     std::int32_t size_y() const noexcept {return ny_;}
 
@@ -121,8 +379,281 @@ struct World
         return (dy - dx) * 0.5;
     }
 
+    // how step() traverses the lattice. does not change the result
+    void configure(StepConfig c)
+    {
+        this->config_ = c;
+    }
+    StepConfig const& config() const noexcept {return config_;}
+
   private:
 
+    int num_threads() const noexcept
+    {
+#ifdef _OPENMP
+        return (0 < config_.threads) ? config_.threads : omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+
+    // Calls f(x0, y0, x1, y1) for each tile [x0, x1) x [y0, y1).
+    // A tile writes at most one cell beyond its edges, so tiles are colored
+    // by the parity of their tile coordinates and the four colors run one
+    // after another; tiles of the same color never touch the same cell and
+    // run in parallel. Without tiling the whole lattice is one tile.
+    template<typename F>
+    void for_each_tile(F&& f)
+    {
+        const std::int32_t tx = (0 < config_.tile_x) ? std::max(config_.tile_x, 2) : nx_;
+        const std::int32_t ty = (0 < config_.tile_y) ? std::max(config_.tile_y, 2) : ny_;
+        const std::int32_t ntx = (nx_ + tx - 1) / tx;
+        const std::int32_t nty = (ny_ + ty - 1) / ty;
+
+        if(ntx * nty == 1)
+        {
+            f(0, 0, nx_, ny_);
+            return;
+        }
+
+        [[maybe_unused]] const int nthreads = this->num_threads();
+        for(std::int32_t color=0; color<4; ++color)
+        {
+            const std::int32_t cx = color % 2;
+            const std::int32_t cy = color / 2;
+            const std::int32_t mx = (ntx - cx + 1) / 2; // number of tiles of this color
+            const std::int32_t my = (nty - cy + 1) / 2;
+
+            #pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+            for(std::int32_t k=0; k<mx*my; ++k)
+            {
+                const std::int32_t i = cx + 2 * (k % mx);
+                const std::int32_t j = cy + 2 * (k / mx);
+                f(i * tx, j * ty, std::min(nx_, (i+1) * tx), std::min(ny_, (j+1) * ty));
+            }
+        }
+        return;
+    }
+
+    // push the populations of every cell to its neighbors in buffer_. all the
+    // kinds of cells stream the same way, so this works on the raw arrays;
+    // off the edges the neighbors are found with idx_of, inside by offsets
+    void stream_tile(std::int32_t x0, std::int32_t y0, std::int32_t x1, std::int32_t y1)
+    {
+        std::array<std::ptrdiff_t, 9> shift;
+        for(std::size_t q=0; q<9; ++q)
+        {
+            shift[q] = d2q9::cx[q] + static_cast<std::ptrdiff_t>(d2q9::cy[q]) * nx_;
+        }
+
+        for(std::int32_t y=y0; y<y1; ++y)
+        {
+            const bool inner_row = (0 < y && y < ny_ - 1);
+            for(std::int32_t x=x0; x<x1; ++x)
+            {
+                const std::size_t i = static_cast<std::size_t>(y) * nx_ + x;
+                const auto& f = this->grids_[i].populations();
+
+                if(inner_row && 0 < x && x < nx_ - 1)
+                {
+                    for(std::size_t q=0; q<9; ++q)
+                    {
+                        this->buffer_[i + shift[q]].populations()[q] = f[q];
+                    }
+                }
+                else
+                {
+                    for(std::size_t q=0; q<9; ++q)
+                    {
+                        if(const auto idx = idx_of(x + d2q9::cx[q], y + d2q9::cy[q]))
+                        {
+                            this->buffer_[idx.value()].populations()[q] = f[q];
+                        }
+                    }
+                }
+                if(scalar_)
+                {
+                    scalar_->stream(x, y);
+                }
+            }
+        }
+        return;
+    }
+
+    void bounce_back_tile(std::int32_t x0, std::int32_t y0, std::int32_t x1, std::int32_t y1)
+    {
+        for(std::int32_t y=y0; y<y1; ++y)
+        {
+            for(std::int32_t x=x0; x<x1; ++x)
+            {
+                auto& grid = this->buffer_[idx_of(x, y).value()];
+                if( ! grid.bounces()) {continue;}
+
+                for(const auto dir : all_dirs)
+                {
+                    const auto [back, d] = grid.bounce_back(dir);
+                    const auto [dx, dy] = offset(back);
+
+                    if(const auto back_idx = idx_of(x+dx, y+dy))
+                    {
+                        this->buffer_[back_idx.value()].set_distribution(back, d);
+                    }
+                }
+            }
+        }
+        return;
+    }
+
+    void check_condition(const std::uint32_t condition) const
+    {
+        if(conditions_.size() <= condition)
+        {
+            throw std::out_of_range("lbm::World: ConstantFlow refers to an unknown "
+                                    "boundary condition. register it with add_boundary()");
+        }
+    }
+
+    // an outflow cell copies from its neighbor along the normal of the edge,
+    // so it has to be on an edge. find_sites() checks the neighbor
+    void check_outflow(const std::int32_t x, const std::int32_t y, const std::uint32_t condition) const
+    {
+        const bool on_edge = (x == 0 || x == nx_ - 1 || y == 0 || y == ny_ - 1);
+        if(is_outflow(conditions_[condition].kind) && ! on_edge)
+        {
+            throw std::invalid_argument("lbm::World: an outflow boundary must be on an edge of the lattice");
+        }
+    }
+
+    // a ConstantFlow cell, with the edge of the lattice it is on
+    struct BoundarySite
+    {
+        std::size_t   cell;
+        std::size_t   inner;     // the fluid neighbor along the normal, for the outflows
+        std::uint32_t condition;
+        std::int8_t   nx;        // inward normal of the edge, 0 if not on it
+        std::int8_t   ny;
+        std::uint16_t unknown;   // bit q: population q came from outside
+    };
+
+    void find_sites()
+    {
+        this->sites_.clear();
+        for(std::int32_t y=0; y<ny_; ++y)
+        {
+            for(std::int32_t x=0; x<nx_; ++x)
+            {
+                const std::size_t i = static_cast<std::size_t>(y) * nx_ + x;
+                if( ! grids_[i].is_boundary()) {continue;}
+
+                BoundarySite s{i, i, grids_[i].condition(), 0, 0, 0};
+                s.nx = static_cast<std::int8_t>((x == 0) - (x == nx_ - 1));
+                s.ny = static_cast<std::int8_t>((y == 0) - (y == ny_ - 1));
+                for(std::size_t q=1; q<9; ++q)
+                {
+                    if( ! idx_of(x - d2q9::cx[q], y - d2q9::cy[q]))
+                    {
+                        s.unknown |= static_cast<std::uint16_t>(1u << q);
+                    }
+                }
+                // only a Cell: other boundary cells are written while this one
+                // reads, and a Barrier has no state to copy
+                if(const auto in = idx_of(x + s.nx, y + s.ny); in && grids_[in.value()].is_cell())
+                {
+                    s.inner = in.value();
+                }
+                if(is_outflow(conditions_[s.condition].kind) && s.inner == s.cell)
+                {
+                    throw std::invalid_argument("lbm::World: the outflow boundary at (" +
+                        std::to_string(x) + ", " + std::to_string(y) + ") has no fluid cell "
+                        "inside along the normal of the edge");
+                }
+                this->sites_.push_back(s);
+            }
+        }
+        this->sites_dirty_ = false;
+        return;
+    }
+
+    // Barrier cells are walls of the scalar. only the cells that became or
+    // stopped being a Barrier since the last call are touched, and a wall is
+    // removed only if it was made for a Barrier, so the walls put on the
+    // scalar by the user stay
+    void sync_scalar_walls()
+    {
+        if( ! scalar_) {return;}
+        for(std::int32_t y=0; y<ny_; ++y)
+        {
+            for(std::int32_t x=0; x<nx_; ++x)
+            {
+                const std::size_t i = static_cast<std::size_t>(y) * nx_ + x;
+                auto& state = this->scalar_barriers_[i];
+
+                const bool barrier = grids_[i].is_barrier();
+                if(barrier == (state != ScalarBarrier::None)) {continue;}
+
+                const bool wall = scalar_->kind_at(x, y) == PassiveScalar::Kind::Wall;
+                if(barrier)
+                {
+                    state = wall ? ScalarBarrier::OnWall : ScalarBarrier::MadeWall;
+                    scalar_->set_wall(x, y);
+                }
+                else
+                {
+                    if(state == ScalarBarrier::MadeWall && wall)
+                    {
+                        scalar_->set_fluid(x, y);
+                    }
+                    state = ScalarBarrier::None;
+                }
+            }
+        }
+        return;
+    }
+
+    // returns the change of rho, u of the boundary cells if `check`
+    ResidualSums apply_boundaries(const bool check)
+    {
+        [[maybe_unused]] const int nthreads = this->num_threads();
+        const std::size_t n = sites_.size();
+
+        double du2 = 0, du_max = 0, drho2 = 0, drho_max = 0;
+
+        #pragma omp parallel for num_threads(nthreads) schedule(static) \
+            reduction(+:du2,drho2) reduction(max:du_max,drho_max)
+        for(std::size_t k=0; k<n; ++k)
+        {
+            const auto& s  = sites_[k];
+            const auto& bc = conditions_[s.condition];
+            auto& grid = grids_[s.cell].populations();
+
+            std::array<double, 9> f = grid;
+
+            std::pair<double, Vector> state;
+            if(is_outflow(bc.kind))
+            {
+                state = apply_outflow(bc, f, grids_[s.inner].populations(), s.unknown);
+            }
+            else
+            {
+                state = apply_boundary(bc, f, s.nx, s.ny, s.unknown);
+            }
+            const auto [rho, u] = state;
+            grid = f;
+            if(check)
+            {
+                const auto du   = length_sq(u - velocity_[s.cell]);
+                const auto drho = std::abs(rho - density_[s.cell]);
+                du2   += du;
+                drho2 += drho * drho;
+                du_max   = std::max(du_max,   du);
+                drho_max = std::max(drho_max, drho);
+            }
+            this->density_ [s.cell] = rho;
+            this->velocity_[s.cell] = u;
+        }
+        return ResidualSums{du2, 0.0, du_max, drho2, 0.0, drho_max};
+    }
+
     std::optional<std::size_t> idx_of(std::int32_t x, std::int32_t y) const
     {
         if(x < 0 || nx_ <= x) {return std::nullopt;}
@@ -139,6 +670,25 @@ struct World
     std::vector<double> density_;
     std::vector<Vector> velocity_;
     BGK bgk_;
+
+    std::size_t step_;
+    StepConfig  config_;
+    std::optional<ConvergenceMonitor> monitor_;
+    std::optional<RunningStatistics>  stats_;
+    std::optional<PassiveScalar>      scalar_;
+
+    // what a Barrier cell did to the scalar, to undo it if it becomes fluid
+    enum class ScalarBarrier : std::uint8_t
+    {
+        None,     // not a Barrier
+        MadeWall, // the wall of the scalar was put for the Barrier
+        OnWall,   // the scalar already had a wall there
+    };
+    std::vector<ScalarBarrier> scalar_barriers_;
+
+    std::vector<BoundaryCondition> conditions_;
+    std::vector<BoundarySite>      sites_;
+    bool sites_dirty_; // the kinds of cells changed: rebuild sites_, sync the scalar walls
 };
 
 } // lbm
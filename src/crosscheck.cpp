@@ -0,0 +1,39 @@
+#include <lbm/CrossCheck.hpp>
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+// lbm_crosscheck [steps [cases [seed]]]: compare the step implementations with
+// the reference World on random geometries. exits with 1 if any of them deviates
+int main(int argc, char** argv)
+{
+    lbm::CrossCheckConfig cfg;
+    if(2 <= argc) {cfg.steps = std::stoull(argv[1]);}
+    if(3 <= argc) {cfg.cases = std::stoull(argv[2]);}
+    if(4 <= argc) {cfg.seed  = std::stoull(argv[3]);}
+
+    const auto world = [](lbm::StepConfig c) {
+        return [c](const lbm::World& w, const lbm::CrossCheckConfig&) -> std::unique_ptr<lbm::Engine> {
+            return std::make_unique<lbm::WorldEngine>(w, c);
+        };
+    };
+
+    lbm::CrossCheck check(cfg);
+    check.add("World 1 thread",      world(lbm::StepConfig{lbm::StepKernel::Split,  0,  0, 1}));
+    check.add("World split 32x16",   world(lbm::StepConfig{lbm::StepKernel::Split, 32, 16, 0}));
+    check.add("World fused 32x16",   world(lbm::StepConfig{lbm::StepKernel::Fused, 32, 16, 0}));
+    check.add("World fused rows x8", world(lbm::StepConfig{lbm::StepKernel::Fused,  0,  8, 0}));
+    check.add("Ensemble", [](const lbm::World& w, const lbm::CrossCheckConfig& c) -> std::unique_ptr<lbm::Engine> {
+        return std::make_unique<lbm::EnsembleEngine>(w, c.rho, c.u);
+    });
+
+    const auto results = check.run();
+    check.write(std::cout, results);
+
+    for(const auto& r : results)
+    {
+        if( ! r.passed(cfg.tolerance)) {return 1;}
+    }
+    return 0;
+}
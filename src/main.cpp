@@ -1,44 +1,115 @@
 #include <lbm/World.hpp>
 #include <lbm/Window.hpp>
+#include <lbm/Snapshot.hpp>
+#include <lbm/AutoTune.hpp>
 
+#include <algorithm>
+#include <iterator>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <thread>
+#include <vector>
 
-int main()
+// with LBM_ENABLE_PROFILING, write the collected phase timings at exit
+void write_profile()
 {
+#ifdef LBM_ENABLE_PROFILING
+    std::ofstream trace("lbm_trace.json");
+    lbm::Profiler::instance().write_chrome_trace(trace);
+    std::ofstream summary("lbm_profile.json");
+    lbm::Profiler::instance().write_summary(summary);
+#endif
+    return;
+}
+
+int main(int argc, char** argv)
+{
+    // lbm [--autotune] [--geometry <file>] --headless [max_steps [snapshot]]: run without
+    // a window until the flow settles, optionally recording a compressed snapshot series
+    // every 100 steps.
+    // --autotune picks the fastest World::step configuration (cached in lbm_autotune.cache)
+    std::vector<std::string> args(argv + 1, argv + argc);
+    const auto autotune = std::find(args.begin(), args.end(), "--autotune");
+    const bool tune = (autotune != args.end());
+    if(tune)
+    {
+        args.erase(autotune);
+    }
+
+    // --geometry <file> reads the cells from a PBM/PGM image or a voxel file
+    std::optional<lbm::Geometry> geometry;
+    const auto geometry_arg = std::find(args.begin(), args.end(), "--geometry");
+    if(geometry_arg != args.end() && std::next(geometry_arg) != args.end())
+    {
+        geometry.emplace(lbm::load_geometry(*std::next(geometry_arg)));
+        args.erase(geometry_arg, std::next(geometry_arg, 2));
+    }
+    else
+    {
+        geometry.emplace(200, 80);
+        for(std::int32_t y=geometry->size_y()*0.4; y<geometry->size_y()*0.55; ++y)
+        {
+            geometry->set(geometry->size_x()*0.2, y, lbm::CellKind::Barrier);
+        }
+        geometry->set_edges(lbm::CellKind::Boundary);
+    }
+    const bool headless = ( ! args.empty() && args[0] == "--headless");
+
     lbm::BGK model(0.02);
-    lbm::World world(200, 80, model);
+    lbm::World world(geometry->size_x(), geometry->size_y(), model);
 
     const auto init_rho = 1.0;
     const auto init_vel = lbm::Vector(0.1, 0.0);
-    for(std::int32_t y=0; y<world.size_y(); ++y)
+    world.load(*geometry, init_rho, init_vel);
+
+    if(tune)
     {
-        for(std::int32_t x=0; x<world.size_x(); ++x)
-        {
-            world.initialize(x, y, init_rho, init_vel);
-        }
+        const auto r = lbm::AutoTuner().tune(world);
+        std::cout << "step config: kernel " << static_cast<int>(r.config.kernel)
+                  << ", tile " << r.config.tile_x << "x" << r.config.tile_y
+                  << ", " << r.config.threads << " threads, " << r.seconds_per_step * 1e3 << " ms/step"
+                  << (r.cached ? " (cached)" : "") << '\n';
     }
+
+    if(headless)
     {
-        for(std::int32_t y=world.size_y()*0.4; y<world.size_y()*0.55; ++y)
+        const std::size_t max_steps = (2 <= args.size()) ? std::stoull(args[1]) : 100000;
+
+        std::optional<lbm::SnapshotWriter> snapshot;
+        if(3 <= args.size())
         {
-            world.set_grid(world.size_x()*0.2, y, lbm::Barrier());
+            snapshot.emplace(args[2], world, lbm::SnapshotConfig{});
         }
 
-        lbm::ConstantFlow boundary;
-        boundary.initialize(model, init_rho, init_vel);
-
-        for(std::int32_t y=0; y<world.size_y(); ++y)
+        world.monitor_convergence(lbm::ConvergenceCriteria{});
+        while(world.steps() < max_steps && ! world.converged())
         {
-            world.set_grid(0,                y, boundary);
-            world.set_grid(world.size_x()-1, y, boundary);
+            world.step();
+            if(snapshot && world.steps() % 100 == 0)
+            {
+                snapshot->push(world);
+            }
         }
-        for(std::int32_t x=0; x<world.size_x(); ++x)
+        if(snapshot)
+        {
+            snapshot->close();
+        }
+
+        std::cout << (world.converged() ? "converged" : "not converged")
+                  << " after " << world.steps() << " steps\n";
+        if(const auto r = world.residual())
         {
-            world.set_grid(x, 0               , boundary);
-            world.set_grid(x, world.size_y()-1, boundary);
+            std::cout << "  |du|_2 = "   << r->velocity_l2   << ", |du|_inf = "   << r->velocity_linf
+                      << ", |drho|_2 = " << r->density_l2    << ", |drho|_inf = " << r->density_linf << '\n';
         }
+        write_profile();
+        return 0;
     }
 
-    lbm::Window window(200, 80, 4);
+    lbm::Window window(world.size_x(), world.size_y(), 4);
     while( ! window.finish())
     {
         window.update(world);
@@ -47,5 +118,6 @@ int main()
             world.step();
         }
     }
+    write_profile();
     return 0;
 }
@@ -0,0 +1,64 @@
+#include <lbm/Snapshot.hpp>
+
+#include <iostream>
+#include <string>
+#include <string_view>
+
+// lbm_snapshot <file>                  : show the contents of a snapshot series
+// lbm_snapshot <file> <frame> <field>  : print one field of one frame as "x y value"
+int main(int argc, char** argv)
+{
+    if(argc != 2 && argc != 4)
+    {
+        std::cerr << "usage: " << argv[0] << " <file> [<frame> <field>]\n";
+        return 1;
+    }
+
+    try
+    {
+        lbm::SnapshotReader reader(argv[1]);
+        const auto& cfg = reader.config();
+
+        if(argc == 2)
+        {
+            std::cout << "frames: " << reader.frames() << '\n';
+            std::cout << "region: " << cfg.width << "x" << cfg.height << " at (" << cfg.x0 << ", " << cfg.y0
+                      << "), stride " << cfg.stride << " -> " << reader.size_x() << "x" << reader.size_y() << '\n';
+            std::cout << "keyframe interval: " << cfg.keyframe_interval << '\n';
+            for(const auto& ch : cfg.channels)
+            {
+                std::cout << "field: " << lbm::to_string(ch.field) << " (error bound " << ch.error_bound << ")\n";
+            }
+            for(std::size_t i=0; i<reader.frames(); ++i)
+            {
+                std::cout << "frame " << i << ": step " << reader.step(i) << '\n';
+            }
+            return 0;
+        }
+
+        const std::size_t frame = std::stoull(argv[2]);
+        const std::string_view name(argv[3]);
+        for(const auto& ch : cfg.channels)
+        {
+            if(name != lbm::to_string(ch.field)) {continue;}
+
+            const auto values = reader.read_frame(frame, ch.field);
+            for(std::int32_t y=0; y<reader.size_y(); ++y)
+            {
+                for(std::int32_t x=0; x<reader.size_x(); ++x)
+                {
+                    std::cout << cfg.x0 + x * cfg.stride << ' ' << cfg.y0 + y * cfg.stride << ' '
+                              << values[static_cast<std::size_t>(y) * reader.size_x() + x] << '\n';
+                }
+            }
+            return 0;
+        }
+        std::cerr << "no field " << name << " in " << argv[1] << '\n';
+        return 1;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+}